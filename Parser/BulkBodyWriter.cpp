@@ -0,0 +1,133 @@
+#include "BulkBodyWriter.h"
+
+namespace smax_ns {
+
+namespace {
+
+/**
+ * @brief Retrieves the length of the UTF-8 sequence starting with a byte >= 0x80.
+ * @return 0 if the bytes are not a valid sequence (overlong forms and surrogates included).
+ */
+std::size_t utf8_sequence(std::string_view text, std::size_t i) {
+    auto byte = [&](std::size_t k) { return static_cast<unsigned char>(text[k]); };
+    auto continuation = [&](std::size_t k, unsigned char low = 0x80, unsigned char high = 0xBF) {
+        return k < text.size() && byte(k) >= low && byte(k) <= high;
+    };
+
+    unsigned char lead = byte(i);
+
+    if (lead >= 0xC2 && lead <= 0xDF) return continuation(i + 1) ? 2 : 0;
+
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        unsigned char low = lead == 0xE0 ? 0xA0 : 0x80;
+        unsigned char high = lead == 0xED ? 0x9F : 0xBF;
+        return continuation(i + 1, low, high) && continuation(i + 2) ? 3 : 0;
+    }
+
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        unsigned char low = lead == 0xF0 ? 0x90 : 0x80;
+        unsigned char high = lead == 0xF4 ? 0x8F : 0xBF;
+        return continuation(i + 1, low, high) && continuation(i + 2) && continuation(i + 3) ? 4 : 0;
+    }
+
+    return 0;
+}
+
+} // namespace
+
+BulkBodyWriter::BulkBodyWriter(std::string operation, std::size_t reserve) : operation_(std::move(operation)) {
+    buffer_.reserve(reserve);
+    begin();
+}
+
+void BulkBodyWriter::begin() {
+    buffer_.clear();
+    buffer_ += "{\"entities\":[";
+    entity_count_ = 0;
+}
+
+void BulkBodyWriter::addEntity(std::string_view entity) {
+    if (entity_count_++ > 0) buffer_ += ',';
+    buffer_ += entity;
+}
+
+const std::string& BulkBodyWriter::finish() {
+    buffer_ += "],\"operation\":";
+    appendString(buffer_, operation_);
+    buffer_ += '}';
+    return buffer_;
+}
+
+std::size_t BulkBodyWriter::getEntityCount() const { return entity_count_; }
+
+bool BulkBodyWriter::appendEntity(std::string& out, std::string_view entity_type,
+                                  const std::vector<std::string>& headers,
+                                  const std::vector<std::string_view>& cells) {
+    bool valid = true;
+
+    out += "{\"entity_type\":";
+    valid = appendString(out, entity_type) && valid;
+    out += ",\"properties\":{";
+
+    for (std::size_t i = 0; i < headers.size(); ++i) {
+        if (i > 0) out += ',';
+        valid = appendString(out, headers[i]) && valid;
+        out += ':';
+
+        if (i < cells.size() && !cells[i].empty()) {
+            valid = appendString(out, cells[i]) && valid;
+        } else {
+            out += "null";
+        }
+    }
+
+    out += "}}";
+    return valid;
+}
+
+bool BulkBodyWriter::appendString(std::string& out, std::string_view value) {
+    static const char hex[] = "0123456789abcdef";
+
+    bool valid = true;
+    out += '"';
+
+    // Copy runs of characters that need no escaping in one go
+    std::size_t run = 0;
+
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+
+        if (c >= 0x80) {
+            std::size_t length = utf8_sequence(value, i);
+            if (length == 0) valid = false;
+            else i += length - 1;
+            continue;
+        }
+
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        out.append(value.data() + run, i - run);
+        run = i + 1;
+
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0x0F];
+            break;
+        }
+    }
+
+    out.append(value.data() + run, value.size() - run);
+    out += '"';
+    return valid;
+}
+
+} // namespace smax_ns
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace smax_ns {
+
+/**
+ * @class BulkBodyWriter
+ * @brief Writes the body of an /ems/bulk request directly from parsed CSV rows.
+ *
+ * Produces {"entities":[...],"operation":"..."} in one reusable buffer without building a
+ * JSON DOM. Once the buffer has grown to the size of a batch it is not reallocated again.
+ */
+class BulkBodyWriter {
+public:
+    /**
+     * @brief Constructs a BulkBodyWriter.
+     * @param operation Bulk operation (CREATE or UPDATE).
+     * @param reserve Initial capacity of the buffer in bytes.
+     */
+    explicit BulkBodyWriter(std::string operation, std::size_t reserve = 1024 * 1024);
+
+    /**
+     * @brief Starts a new body, keeping the capacity of the buffer.
+     */
+    void begin();
+
+    /**
+     * @brief Appends an already serialized entity.
+     * @param entity JSON text of the entity.
+     */
+    void addEntity(std::string_view entity);
+
+    /**
+     * @brief Completes the body.
+     * @return The body; valid until the next call of begin().
+     */
+    const std::string& finish();
+
+    /** @brief Retrieves the number of entities in the current body. */
+    std::size_t getEntityCount() const;
+
+    /**
+     * @brief Serializes a data row as {"entity_type":"...","properties":{...}}.
+     *
+     * Empty and missing cells are written as null.
+     * @param out Receives the JSON text.
+     * @param entity_type Type of the entity.
+     * @param headers Column names.
+     * @param cells Cell values.
+     * @return false if a column name or cell is not valid UTF-8; the text must not be sent then.
+     */
+    static bool appendEntity(std::string& out, std::string_view entity_type,
+                             const std::vector<std::string>& headers,
+                             const std::vector<std::string_view>& cells);
+
+    /**
+     * @brief Appends a JSON string literal (with quotes), checking that the value is UTF-8 on the way.
+     * @param out Receives the JSON text.
+     * @param value The string value.
+     * @return false if the value is not valid UTF-8 (e.g. a CP1251 file); its bytes are copied as they are.
+     */
+    static bool appendString(std::string& out, std::string_view value);
+
+private:
+    std::string operation_;     ///< Bulk operation
+    std::string buffer_;        ///< Body being written
+    std::size_t entity_count_ = 0; ///< Number of entities in buffer_
+};
+
+} // namespace smax_ns
@@ -0,0 +1,143 @@
+#include "CsvReader.h"
+
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace bip = boost::interprocess;
+
+namespace smax_ns {
+
+CsvReader::CsvReader(const std::string& filename) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(filename, ec);
+
+    if (ec) {
+        throw std::runtime_error("ERROR opening file: " + filename);
+    }
+
+    if (size > 0) {
+        try {
+            mapping_ = bip::file_mapping(filename.c_str(), bip::read_only);
+            region_ = bip::mapped_region(mapping_, bip::read_only);
+            region_.advise(bip::mapped_region::advice_sequential);
+        } catch (const bip::interprocess_exception& e) {
+            throw std::runtime_error("ERROR opening file: " + filename + " (" + e.what() + ")");
+        }
+
+        data_ = std::string_view(static_cast<const char*>(region_.get_address()), region_.get_size());
+    }
+
+    // Excel writes UTF-8 files with a byte order mark
+    if (data_.size() >= 3 && data_.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        pos_ = 3;
+    }
+}
+
+CsvReader::CsvReader(std::string_view data, std::size_t first_number) : data_(data), number_(first_number) {}
+
+bool CsvReader::next(CsvRow& row) {
+    const char* text = data_.data();
+    const std::size_t size = data_.size();
+
+    // Blank lines are not records
+    while (pos_ < size && (text[pos_] == '\n' || text[pos_] == '\r')) ++pos_;
+
+    if (pos_ >= size) return false;
+
+    std::size_t start = pos_;
+    std::size_t i = pos_;
+    refs_.clear();
+    scratch_.clear();
+
+    for (;;) {
+        std::size_t cell_start = i;
+        while (cell_start < size && (text[cell_start] == ' ' || text[cell_start] == '\t')) ++cell_start;
+
+        if (cell_start < size && text[cell_start] == '"') {
+            std::size_t segment = cell_start + 1;
+            std::size_t scratch_offset = scratch_.size();
+            bool escaped = false;
+            std::size_t close = size;
+
+            for (std::size_t j = segment; j < size;) {
+                const void* quote = std::memchr(text + j, '"', size - j);
+                if (!quote) break;
+
+                std::size_t q = static_cast<const char*>(quote) - text;
+
+                if (q + 1 < size && text[q + 1] == '"') {
+                    scratch_.append(text + segment, q + 1 - segment);
+                    segment = q + 2;
+                    j = q + 2;
+                    escaped = true;
+                    continue;
+                }
+
+                close = q;
+                break;
+            }
+
+            if (escaped) {
+                scratch_.append(text + segment, close - segment);
+                refs_.push_back(CellRef{scratch_offset, scratch_.size() - scratch_offset, true});
+            } else {
+                refs_.push_back(CellRef{segment, close - segment, false});
+            }
+
+            // Anything between the closing quote and the delimiter is ignored
+            i = close < size ? close + 1 : size;
+            while (i < size && text[i] != ',' && text[i] != '\n' && text[i] != '\r') ++i;
+        } else {
+            std::size_t end = cell_start;
+            while (end < size && text[end] != ',' && text[end] != '\n' && text[end] != '\r') ++end;
+
+            auto cell = trim(std::string_view(text + cell_start, end - cell_start));
+            refs_.push_back(CellRef{static_cast<std::size_t>(cell.data() - text), cell.size(), false});
+            i = end;
+        }
+
+        if (i < size && text[i] == ',') {
+            ++i;
+            continue;
+        }
+
+        break;
+    }
+
+    row.raw = std::string_view(text + start, i - start);
+    row.offset = start;
+
+    if (i < size && text[i] == '\r') ++i;
+    if (i < size && text[i] == '\n') ++i;
+    pos_ = i;
+
+    row.cells.clear();
+    row.cells.reserve(refs_.size());
+
+    for (const auto& ref : refs_) {
+        const char* base = ref.in_scratch ? scratch_.data() : text;
+        row.cells.emplace_back(base + ref.offset, ref.length);
+    }
+
+    row.number = number_++;
+    return true;
+}
+
+std::string_view CsvReader::data() const { return data_; }
+
+std::size_t CsvReader::position() const { return pos_; }
+
+void CsvReader::seek(std::size_t position, std::size_t number) {
+    pos_ = std::min(position, data_.size());
+    number_ = number;
+}
+
+std::string_view CsvReader::trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) s.remove_suffix(1);
+    return s;
+}
+
+} // namespace smax_ns
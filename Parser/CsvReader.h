@@ -0,0 +1,92 @@
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace smax_ns {
+
+/**
+ * @brief One CSV record.
+ *
+ * Cells point into the memory-mapped file (or into the reader's scratch buffer for quoted
+ * cells with escaped quotes) and stay valid until the next call of CsvReader::next().
+ */
+struct CsvRow {
+    std::vector<std::string_view> cells;  ///< Cell values (unquoted, unescaped)
+    std::string_view raw;                 ///< The record as it is written in the file (without the line break)
+    std::size_t offset = 0;               ///< Offset of the record in the CSV text
+    std::size_t number = 0;               ///< 1-based record number (the header is record 1)
+};
+
+/**
+ * @class CsvReader
+ * @brief Streaming RFC 4180 CSV reader over a memory-mapped file.
+ *
+ * Supports quoted cells with commas, line breaks and doubled quotes, LF and CRLF record
+ * separators and a UTF-8 BOM. Whitespace around unquoted cells is trimmed.
+ */
+class CsvReader {
+public:
+    /**
+     * @brief Maps the file into memory.
+     * @param filename Name of the CSV file.
+     * @throws std::runtime_error If the file cannot be opened.
+     */
+    explicit CsvReader(const std::string& filename);
+
+    /**
+     * @brief Reader over a memory range (e.g. a part of an already mapped file).
+     * @param data The CSV text.
+     * @param first_number Record number of the first record in data.
+     */
+    explicit CsvReader(std::string_view data, std::size_t first_number = 1);
+
+    CsvReader(const CsvReader&) = delete;
+    CsvReader& operator=(const CsvReader&) = delete;
+
+    /**
+     * @brief Reads the next record.
+     * @param row Receives the record.
+     * @return false at the end of the data.
+     */
+    bool next(CsvRow& row);
+
+    /** @brief Retrieves the whole CSV text. */
+    std::string_view data() const;
+
+    /** @brief Retrieves the offset of the next record in data(). */
+    std::size_t position() const;
+
+    /**
+     * @brief Continues reading at a record boundary.
+     * @param position Offset of a record in data().
+     * @param number Record number of that record.
+     */
+    void seek(std::size_t position, std::size_t number);
+
+private:
+    boost::interprocess::file_mapping mapping_;   ///< Mapped file
+    boost::interprocess::mapped_region region_;   ///< Mapped view of the whole file
+    std::string_view data_;                       ///< CSV text
+    std::size_t pos_ = 0;                         ///< Position of the next record
+    std::size_t number_ = 1;                      ///< Number of the next record
+    std::string scratch_;                         ///< Storage for unescaped quoted cells
+
+    /**
+     * @brief Location of a cell, either in data_ or in scratch_.
+     */
+    struct CellRef {
+        std::size_t offset;
+        std::size_t length;
+        bool in_scratch;
+    };
+
+    std::vector<CellRef> refs_;  ///< Cells of the current record
+
+    static std::string_view trim(std::string_view s);
+};
+
+} // namespace smax_ns
@@ -1,49 +1,106 @@
+
 #include "Parser.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <thread>
+
 using json = nlohmann::json;
 
 namespace smax_ns {
 
-Parser::Parser(const std::string& filename) : filename_(filename) {}
+namespace {
 
-json Parser::parseCSV(const std::string entity_type, const std::string action) {
-    std::lock_guard<std::mutex> lock(mtx_); // Ensure thread-safe access
-    std::ifstream file(filename_);
+/**
+ * @brief Nominal size of a byte range converted by one worker.
+ */
+const std::size_t RANGE_SIZE = 4 * 1024 * 1024;
+
+/**
+ * @brief Runs fn(0..count-1) on the given number of threads.
+ */
+void parallelFor(std::size_t count, std::size_t threads, const std::function<void(std::size_t)>& fn) {
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
 
-    if (!file.is_open()) {
-        throw std::runtime_error("ERROR opening file: " + filename_);
+    for (std::size_t t = 0; t < std::min(threads, count); ++t) {
+        workers.emplace_back([&]() {
+            for (std::size_t i = next++; i < count; i = next++) fn(i);
+        });
     }
 
-    std::string line;
-    std::vector<std::string> headers;
-    json entities = json::array();
+    for (auto& worker : workers) worker.join();
+}
+
+/**
+ * @brief State of CsvReader after a character, as far as record ends are concerned.
+ *
+ * A quote opens a quoted cell only at the start of a cell (after optional spaces and tabs);
+ * elsewhere it is a literal character. After the closing quote everything up to the next
+ * delimiter is ignored, quotes included.
+ */
+enum CsvState : unsigned char {
+    FIELD_START,        ///< At the start of a cell (or of a record)
+    UNQUOTED,           ///< Inside an unquoted cell
+    QUOTED,             ///< Inside a quoted cell
+    QUOTE_IN_QUOTED,    ///< Behind a quote inside a quoted cell (an escape or the closing quote)
+    AFTER_QUOTED,       ///< Behind the closing quote of a cell
+    CSV_STATES
+};
+
+CsvState step(CsvState state, char c) {
+    bool delimiter = c == ',' || c == '\n' || c == '\r';
 
-    // Read the first line as headers
-    if (std::getline(file, line)) {
-        headers = splitAndTrim(line, ',');
+    switch (state) {
+    case FIELD_START:
+        if (c == '"') return QUOTED;
+        if (delimiter || c == ' ' || c == '\t') return FIELD_START;
+        return UNQUOTED;
+    case UNQUOTED:
+    case AFTER_QUOTED:
+        return delimiter ? FIELD_START : state;
+    case QUOTED:
+        return c == '"' ? QUOTE_IN_QUOTED : QUOTED;
+    case QUOTE_IN_QUOTED:
+        if (c == '"') return QUOTED;
+        return delimiter ? FIELD_START : AFTER_QUOTED;
+    default:
+        return state;
     }
+}
 
-    // Read the rest of the file line by line
-    while (std::getline(file, line)) {
-        std::vector<std::string> values = splitAndTrim(line, ',');
-        json properties;
-
-        // Map values to corresponding headers
-        for (size_t i = 0; i < headers.size(); ++i) {
-            if (i < values.size() && !values[i].empty()) {
-                properties[headers[i]] = values[i];
-            } else {
-                properties[headers[i]] = json(nullptr); // Assign null if no value exists
-            }
+/**
+ * @brief Runs the reader's state machine over [p, end), skipping the insides of quoted cells with memchr.
+ */
+CsvState scan(CsvState state, const char* p, const char* end) {
+    while (p < end) {
+        if (state == QUOTED) {
+            p = static_cast<const char*>(std::memchr(p, '"', end - p));
+            if (p == nullptr) return QUOTED;
         }
 
-        // Construct entity JSON object
-        entities.push_back({
-            {"entity_type", entity_type},
-            {"properties", properties}
-        });
+        state = step(state, *p++);
     }
 
+    return state;
+}
+
+} // namespace
+
+Parser::Parser(const std::string& filename) : filename_(filename) {}
+
+json Parser::parseCSV(const std::string entity_type, const std::string action) {
+    json entities = json::array();
+
+    forEachRow([&](const std::vector<std::string>& headers, const CsvRow& row) {
+        entities.push_back(toEntity(entity_type, headers, row));
+    });
+
     // Return the final JSON object
     return json{
         {"entities", entities},
@@ -51,25 +108,234 @@ json Parser::parseCSV(const std::string entity_type, const std::string action) {
     };
 }
 
-std::vector<std::string> Parser::splitAndTrim(const std::string& str, char delimiter) {
-    std::vector<std::string> tokens;
-    std::stringstream ss(str);
-    std::string token;
+void Parser::forEachRow(const RowHandler& handler) {
+    std::lock_guard<std::mutex> lock(mtx_); // Ensure thread-safe access
+    CsvReader reader(filename_);
+
+    CsvRow row;
+    std::vector<std::string> headers;
 
-    // Split string and trim each token
-    while (std::getline(ss, token, delimiter)) {
-        tokens.push_back(trim(token));
+    // Read the first record as headers
+    if (reader.next(row)) {
+        headers.assign(row.cells.begin(), row.cells.end());
     }
 
-    return tokens;
+    // Read the rest of the file record by record
+    while (reader.next(row)) {
+        handler(headers, row);
+    }
+}
+
+std::string Parser::readHeader() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    CsvReader reader(filename_);
+
+    CsvRow row;
+    if (!reader.next(row)) return std::string();
+
+    return std::string(row.raw);
 }
 
-std::string Parser::trim(std::string s) {
-    // Remove leading whitespace
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](unsigned char ch) { return !std::isspace(ch); }));
-    // Remove trailing whitespace
-    s.erase(std::find_if(s.rbegin(), s.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base(), s.end());
-    return s;
+void Parser::forEachEntity(const std::string& entity_type, std::size_t threads,
+                           const std::function<void(ParsedRow& row)>& consumer,
+                           std::size_t start_offset, std::size_t start_number) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    CsvReader reader(filename_);
+
+    CsvRow header_row;
+    std::vector<std::string> headers;
+
+    if (!reader.next(header_row)) return;
+    headers.assign(header_row.cells.begin(), header_row.cells.end());
+
+    // Record numbers are assigned in file order; the header is record 1
+    std::size_t first_number = header_row.number + 1;
+
+    if (start_offset > reader.position()) {
+        reader.seek(start_offset, start_number);
+        first_number = start_number;
+    }
+
+    if (threads <= 1) {
+        CsvRow row;
+        ParsedRow parsed;
+
+        while (reader.next(row)) {
+            parsed.number = row.number;
+            parsed.raw = row.raw;
+            parsed.offset = row.offset;
+            parsed.entity.clear();
+            parsed.valid = BulkBodyWriter::appendEntity(parsed.entity, entity_type, headers, row.cells);
+            consumer(parsed);
+        }
+        return;
+    }
+
+    std::string_view data = reader.data();
+    std::vector<std::size_t> borders = splitRanges(data, reader.position(), threads);
+    std::size_t ranges = borders.size() - 1;
+
+    // Converted ranges wait here until the consumer takes them in order
+    struct Range {
+        bool done = false;
+        std::vector<ParsedRow> rows;
+    };
+
+    std::deque<Range> results(ranges);
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::size_t next_range = 0;
+    std::size_t consumed = 0;
+    bool stop = false;
+    std::exception_ptr error;
+    const std::size_t window = threads * 2;
+
+    auto worker = [&]() {
+        for (;;) {
+            std::size_t index;
+            {
+                std::unique_lock<std::mutex> guard(mutex);
+                cv.wait(guard, [&]() { return stop || next_range >= ranges || next_range < consumed + window; });
+                if (stop || next_range >= ranges) return;
+                index = next_range++;
+            }
+
+            std::vector<ParsedRow> rows;
+
+            try {
+                CsvReader range_reader(data.substr(borders[index], borders[index + 1] - borders[index]));
+                CsvRow row;
+
+                while (range_reader.next(row)) {
+                    rows.push_back(ParsedRow{0, row.raw, borders[index] + row.offset, {}, true});
+                    rows.back().valid = BulkBodyWriter::appendEntity(rows.back().entity, entity_type, headers, row.cells);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(mutex);
+                if (!error) error = std::current_exception();
+                stop = true;
+                cv.notify_all();
+                return;
+            }
+
+            std::lock_guard<std::mutex> guard(mutex);
+            results[index].rows = std::move(rows);
+            results[index].done = true;
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t t = 0; t < std::min(threads, ranges); ++t) {
+        workers.emplace_back(worker);
+    }
+
+    std::size_t number = first_number;
+
+    try {
+        for (std::size_t index = 0; index < ranges; ++index) {
+            std::vector<ParsedRow> rows;
+            {
+                std::unique_lock<std::mutex> guard(mutex);
+                cv.wait(guard, [&]() { return stop || results[index].done; });
+                if (stop) break;
+                rows = std::move(results[index].rows);
+            }
+
+            for (auto& row : rows) {
+                row.number = number++;
+                consumer(row);
+            }
+
+            std::lock_guard<std::mutex> guard(mutex);
+            ++consumed;
+            cv.notify_all();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!error) error = std::current_exception();
+        stop = true;
+        cv.notify_all();
+    }
+
+    for (auto& thread : workers) thread.join();
+
+    if (error) std::rethrow_exception(error);
+}
+
+std::vector<std::size_t> Parser::splitRanges(std::string_view data, std::size_t begin, std::size_t threads) {
+    std::size_t length = data.size() - begin;
+    std::size_t ranges = std::max<std::size_t>(threads, (length + RANGE_SIZE - 1) / RANGE_SIZE);
+    std::size_t range_size = std::max<std::size_t>(length / ranges, 1);
+    ranges = std::max<std::size_t>((length + range_size - 1) / range_size, 1);
+
+    // The state of the reader at a range start depends on the text before it, so every range
+    // is scanned from every state; chaining the results gives the actual state at each start
+    std::vector<std::array<CsvState, CSV_STATES>> transitions(ranges);
+
+    parallelFor(ranges, threads, [&](std::size_t i) {
+        const char* p = data.data() + begin + i * range_size;
+        const char* end = data.data() + std::min(data.size(), begin + (i + 1) * range_size);
+
+        std::array<CsvState, CSV_STATES> states;
+        for (std::size_t s = 0; s < CSV_STATES; ++s) states[s] = static_cast<CsvState>(s);
+
+        // After a line break outside of quotes the states usually agree, and one is enough
+        while (p < end) {
+            char c = *p++;
+            for (auto& state : states) state = step(state, c);
+
+            if (c == '\n' && std::all_of(states.begin(), states.end(), [&](CsvState s) { return s == states[0]; })) {
+                CsvState state = scan(states[0], p, end);
+                states.fill(state);
+                break;
+            }
+        }
+
+        transitions[i] = states;
+    });
+
+    std::vector<std::size_t> borders{begin};
+    CsvState state = FIELD_START;
+
+    for (std::size_t i = 1; i < ranges; ++i) {
+        state = transitions[i - 1][state];
+
+        std::size_t pos = begin + i * range_size;
+        if (pos <= borders.back()) continue;
+
+        // Move the border right behind the first line break that ends a record
+        CsvState current = state;
+        while (pos < data.size()) {
+            char c = data[pos++];
+            bool record_end = c == '\n' && current != QUOTED;
+            current = step(current, c);
+            if (record_end) break;
+        }
+
+        if (pos > borders.back() && pos < data.size()) borders.push_back(pos);
+    }
+
+    borders.push_back(data.size());
+    return borders;
+}
+
+json Parser::toEntity(const std::string& entity_type, const std::vector<std::string>& headers, const CsvRow& row) {
+    json properties = json::object();
+
+    // Map values to corresponding headers
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (i < row.cells.size() && !row.cells[i].empty()) {
+            properties[headers[i]] = row.cells[i];
+        } else {
+            properties[headers[i]] = json(nullptr); // Assign null if no value exists
+        }
+    }
+
+    return json{
+        {"entity_type", entity_type},
+        {"properties", properties}
+    };
 }
 
 } // namespace smax_ns
@@ -2,22 +2,44 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <vector>
 #include <sstream>
 #include <nlohmann/json.hpp>
 #include <algorithm>
 #include <mutex>
 
+#include "BulkBodyWriter.h"
+#include "CsvReader.h"
+
 using json = nlohmann::json;
 
 namespace smax_ns {
 
+/**
+ * @brief A data row converted into an entity.
+ */
+struct ParsedRow {
+    std::size_t number = 0;  ///< 1-based record number in the file (the header is record 1)
+    std::string_view raw;    ///< The record as it is written in the file
+    std::size_t offset = 0;  ///< Offset of the record in the file
+    std::string entity;      ///< JSON text of {"entity_type": ..., "properties": {...}}
+    bool valid = true;       ///< All cells are valid UTF-8; entity must not be sent otherwise
+};
+
 /**
  * @class Parser
  * @brief Parses CSV files and converts data into JSON format.
  */
 class Parser {
 public:
+    /**
+     * @brief Callback receiving one data row of the CSV file.
+     * @param headers Column names (the first record of the file).
+     * @param row The data row; its cells are valid only during the call.
+     */
+    using RowHandler = std::function<void(const std::vector<std::string>& headers, const CsvRow& row)>;
+
     /**
      * @brief Constructor to initialize the parser with a CSV file.
      * @param filename Name of the CSV file to parse.
@@ -33,25 +55,64 @@ public:
      */
     json parseCSV(const std::string entity_type, const std::string action);
 
-private:
-    std::string filename_;  ///< Name of the CSV file to be parsed.
-    mutable std::mutex mtx_; ///< Mutex for thread-safe file access.
+    /**
+     * @brief Reads the CSV file and passes the data rows one by one to the handler.
+     *
+     * Nothing but the current row is kept in memory.
+     * @param handler Receives the rows in file order.
+     * @throws std::runtime_error If the file cannot be opened.
+     */
+    void forEachRow(const RowHandler& handler);
 
     /**
-     * @brief Splits a string by a given delimiter and trims whitespace from each token.
-     * @param str Input string to split.
-     * @param delimiter Character used as a separator.
-     * @return A vector of trimmed substrings.
+     * @brief Reads the header record as it is written in the file.
+     * @return The first record without its line break (empty for an empty file).
+     * @throws std::runtime_error If the file cannot be opened.
      */
-    static std::vector<std::string> splitAndTrim(const std::string& str, char delimiter);
+    std::string readHeader();
 
     /**
-     * @brief Trims leading and trailing whitespace from a string.
-     * @param s Input string to trim.
-     * @return Trimmed string.
+     * @brief Serializes the data rows as entities, optionally on several threads.
+     *
+     * With more than one thread the file is split into byte ranges; the range borders are
+     * moved to the first record break that is not inside a quoted cell. Ranges are converted
+     * by worker threads while the consumer receives the rows in file order. At most two
+     * ranges per thread are kept in memory.
+     * @param entity_type Type of the entities.
+     * @param threads Number of worker threads (1 converts on the calling thread).
+     * @param consumer Receives the rows in file order on the calling thread.
+     * @param start_offset Offset of the first record to read (0 starts after the header).
+     * @param start_number Record number of the record at start_offset.
+     * @throws std::runtime_error If the file cannot be opened.
      */
-    static std::string trim(std::string s);
+    void forEachEntity(const std::string& entity_type, std::size_t threads,
+                       const std::function<void(ParsedRow& row)>& consumer,
+                       std::size_t start_offset = 0, std::size_t start_number = 0);
+
+    /**
+     * @brief Converts a data row into an entity.
+     * @param entity_type Type of the entity.
+     * @param headers Column names.
+     * @param row The data row.
+     * @return {"entity_type": ..., "properties": {...}}; empty and missing cells are null.
+     */
+    static json toEntity(const std::string& entity_type, const std::vector<std::string>& headers, const CsvRow& row);
+
+private:
+    std::string filename_;  ///< Name of the CSV file to be parsed.
+    mutable std::mutex mtx_; ///< Mutex for thread-safe file access.
+
+    /**
+     * @brief Splits the data rows into byte ranges that start at record boundaries.
+     *
+     * Quotes are interpreted as CsvReader does, so every border is a record start the reader
+     * would reach too and the ranges parse like the whole text.
+     * @param data The CSV text.
+     * @param begin Offset of the first data record.
+     * @param threads Number of threads used to scan the text.
+     * @return Offsets of the range borders (the first is begin, the last is data.size()).
+     */
+    static std::vector<std::size_t> splitRanges(std::string_view data, std::size_t begin, std::size_t threads);
 };
 
 } // namespace smax_ns
-
@@ -0,0 +1,91 @@
+#include "AsyncRuntime.h"
+#include <iostream>
+#include <memory>
+
+AsyncRuntime::AsyncRuntime(std::size_t threads, std::chrono::seconds timeout)
+    : work_guard_(net::make_work_guard(ioc_)),
+      ssl_ctx_(ssl::context::tls_client),
+      connection_pool_(ioc_, ssl_ctx_),
+      timeout_(timeout) {
+    threads = std::max<std::size_t>(threads, 1);
+    threads_.reserve(threads);
+
+    for (std::size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back([this]() {
+            for (;;) {
+                try {
+                    ioc_.run();
+                    break;
+                } catch (const std::exception& e) {
+                    std::cerr << "AsyncRuntime exception: " << e.what() << "\n";
+                }
+            }
+        });
+    }
+}
+
+AsyncRuntime::~AsyncRuntime() {
+    work_guard_.reset();
+    connection_pool_.clear();
+    ioc_.stop();
+
+    for (auto& thread : threads_) {
+        if (thread.joinable()) thread.join();
+    }
+}
+
+void AsyncRuntime::request(http::verb method, const std::string& host, uint16_t port,
+                           const std::string& target, const std::string& body,
+                           const std::map<std::string, std::string>& headers, Callback callback) {
+    try {
+        auto client = std::make_shared<RestClient>(ioc_, connection_pool_, host, std::to_string(port), timeout_);
+
+        client->run(target, method, body, makeHandler(callback), headers);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << "\n";
+        callback(RestResponse{false, "Исключение: " + std::string(e.what()), 0, "", ""});
+    }
+}
+
+void AsyncRuntime::download(const std::string& host, uint16_t port, const std::string& target,
+                            const std::string& file_path,
+                            const std::map<std::string, std::string>& headers, Callback callback) {
+    try {
+        auto client = std::make_shared<RestClient>(ioc_, connection_pool_, host, std::to_string(port), timeout_);
+
+        client->download(target, file_path, makeHandler(callback), headers);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << "\n";
+        callback(RestResponse{false, "Исключение: " + std::string(e.what()), 0, "", ""});
+    }
+}
+
+std::future<RestResponse> AsyncRuntime::request(http::verb method, const std::string& host, uint16_t port,
+                                                const std::string& target, const std::string& body,
+                                                const std::map<std::string, std::string>& headers) {
+    auto promise = std::make_shared<std::promise<RestResponse>>();
+    auto future = promise->get_future();
+
+    request(method, host, port, target, body, headers, [promise](RestResponse response) {
+        promise->set_value(std::move(response));
+    });
+
+    return future;
+}
+
+RestClient::ResponseHandler AsyncRuntime::makeHandler(Callback callback) {
+    return [callback](const std::string& response, const boost::system::error_code& ec, int http_status,
+                      const http::fields& headers) {
+        if (!ec) {
+            callback(RestResponse{true, response, http_status, std::string(headers[http::field::etag]),
+                                  std::string(headers[http::field::last_modified])});
+        } else {
+            std::cerr << "Error: " << ec.message() << "\n";
+            callback(RestResponse{false, "Ошибка запроса: " + ec.message(), http_status, "", ""});
+        }
+    };
+}
+
+net::io_context& AsyncRuntime::getIoContext() { return ioc_; }
+
+ConnectionPool& AsyncRuntime::getConnectionPool() { return connection_pool_; }
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConnectionPool.h"
+#include "RestClient.h"
+
+/**
+ * @brief Result of a request executed by AsyncRuntime.
+ */
+struct RestResponse {
+    bool success = false;     ///< False if the request failed on the transport level.
+    std::string body;         ///< Response body (or error description if success is false).
+    int status_code = 0;      ///< HTTP status code (0 if no response was received).
+    std::string etag;         ///< ETag of the response, if any (validator of cached responses).
+    std::string last_modified; ///< Last-Modified of the response, if any (validator of cached responses).
+};
+
+/**
+ * @class AsyncRuntime
+ * @brief Long-lived I/O runtime shared by all requests of a process.
+ *
+ * Owns one io_context driven by a pool of threads, one SSL context and the ConnectionPool,
+ * so many requests can be in flight at once without a private event loop per request.
+ */
+class AsyncRuntime {
+public:
+    /**
+     * @brief Callback type for asynchronous requests. Called on one of the I/O threads.
+     */
+    using Callback = std::function<void(RestResponse)>;
+
+    /// Default time the server may take to accept or send data (--request-timeout)
+    static constexpr std::chrono::seconds DEFAULT_TIMEOUT{120};
+
+    /**
+     * @brief Starts the I/O threads.
+     * @param threads Number of threads running the io_context (at least one is started).
+     * @param timeout Time the server may take to accept or send data before a request fails.
+     */
+    explicit AsyncRuntime(std::size_t threads, std::chrono::seconds timeout = DEFAULT_TIMEOUT);
+
+    /**
+     * @brief Stops the io_context and joins the I/O threads.
+     */
+    ~AsyncRuntime();
+
+    AsyncRuntime(const AsyncRuntime&) = delete;
+    AsyncRuntime& operator=(const AsyncRuntime&) = delete;
+
+    /**
+     * @brief Sends a request and reports the result through a callback.
+     * @param method The HTTP method.
+     * @param host The target host.
+     * @param port The target port.
+     * @param target The request target.
+     * @param body The request body (may be empty).
+     * @param headers Additional request headers.
+     * @param callback Receives the result.
+     */
+    void request(http::verb method, const std::string& host, uint16_t port,
+                 const std::string& target, const std::string& body,
+                 const std::map<std::string, std::string>& headers, Callback callback);
+
+    /**
+     * @brief Sends a request and returns a future with the result.
+     * @return Future that becomes ready when the response is received or the request fails.
+     */
+    std::future<RestResponse> request(http::verb method, const std::string& host, uint16_t port,
+                                      const std::string& target, const std::string& body,
+                                      const std::map<std::string, std::string>& headers);
+
+    /**
+     * @brief Sends a GET request whose response body is streamed into a file.
+     * @param host The target host.
+     * @param port The target port.
+     * @param target The request target.
+     * @param file_path The file receiving the body (it contains the error body if the status is not 200).
+     * @param headers Additional request headers.
+     * @param callback Receives the result (with an empty body).
+     */
+    void download(const std::string& host, uint16_t port, const std::string& target,
+                  const std::string& file_path,
+                  const std::map<std::string, std::string>& headers, Callback callback);
+
+    /** @brief Retrieves the I/O context. */
+    net::io_context& getIoContext();
+
+    /** @brief Retrieves the pool of established connections. */
+    ConnectionPool& getConnectionPool();
+
+private:
+    net::io_context ioc_;  ///< Shared I/O context.
+    net::executor_work_guard<net::io_context::executor_type> work_guard_;  ///< Keeps ioc_ running while idle.
+    ssl::context ssl_ctx_;  ///< Shared SSL context.
+    ConnectionPool connection_pool_;  ///< Keep-alive connections.
+    std::vector<std::thread> threads_;  ///< Threads running ioc_.
+    std::chrono::seconds timeout_;  ///< Timeout of the steps of every request.
+
+    /**
+     * @brief Adapts a Callback to the RestClient response handler.
+     */
+    static RestClient::ResponseHandler makeHandler(Callback callback);
+};
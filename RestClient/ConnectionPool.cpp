@@ -0,0 +1,85 @@
+#include "ConnectionPool.h"
+
+ConnectionPool::ConnectionPool(net::io_context& ioc, ssl::context& ctx,
+                               std::chrono::seconds idle_timeout, std::size_t max_idle_per_host)
+    : ioc_(ioc), ctx_(ctx), idle_timeout_(idle_timeout), max_idle_per_host_(max_idle_per_host) {}
+
+std::unique_ptr<ConnectionPool::Stream> ConnectionPool::acquire(const std::string& host, const std::string& port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = idle_.find(makeKey(host, port));
+    if (it == idle_.end()) return nullptr;
+
+    auto now = std::chrono::steady_clock::now();
+    auto& streams = it->second;
+
+    // The most recently returned stream is the most likely one to be still open
+    while (!streams.empty()) {
+        IdleStream idle = std::move(streams.back());
+        streams.pop_back();
+
+        if (now - idle.since > idle_timeout_) continue;
+        if (!isAlive(*idle.stream)) continue;
+
+        return std::move(idle.stream);
+    }
+
+    return nullptr;
+}
+
+std::unique_ptr<ConnectionPool::Stream> ConnectionPool::create(const std::string& host) {
+    auto stream = std::make_unique<Stream>(net::make_strand(ioc_), ctx_);
+
+    // SNI is required by most TLS terminating load balancers
+    SSL_set_tlsext_host_name(stream->native_handle(), host.c_str());
+
+    return stream;
+}
+
+void ConnectionPool::release(const std::string& host, const std::string& port, std::unique_ptr<Stream> stream) {
+    if (!stream || !beast::get_lowest_layer(*stream).socket().is_open()) return;
+
+    beast::get_lowest_layer(*stream).expires_never();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& streams = idle_[makeKey(host, port)];
+
+    auto now = std::chrono::steady_clock::now();
+    while (!streams.empty() && now - streams.front().since > idle_timeout_) {
+        streams.pop_front();
+    }
+
+    if (streams.size() >= max_idle_per_host_) {
+        streams.pop_front();
+    }
+
+    streams.push_back(IdleStream{std::move(stream), now});
+}
+
+void ConnectionPool::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.clear();
+}
+
+bool ConnectionPool::isAlive(Stream& stream) {
+    auto& socket = beast::get_lowest_layer(stream).socket();
+    if (!socket.is_open()) return false;
+
+    // An idle HTTP connection must not have anything to read. EOF means that the server
+    // has closed it, any data (e.g. a TLS close_notify alert) means that it is going to.
+    boost::system::error_code ec;
+    char probe;
+
+    socket.non_blocking(true, ec);
+    if (ec) return false;
+
+    boost::system::error_code peek_ec;
+    std::size_t received = socket.receive(net::buffer(&probe, 1), tcp::socket::message_peek, peek_ec);
+    socket.non_blocking(false, ec);
+
+    return received == 0 && peek_ec == net::error::would_block;
+}
+
+std::string ConnectionPool::makeKey(const std::string& host, const std::string& port) {
+    return host + ":" + port;
+}
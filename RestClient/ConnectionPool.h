@@ -0,0 +1,97 @@
+#pragma once
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace beast = boost::beast;
+namespace net = boost::asio;
+namespace ssl = net::ssl;
+using tcp = net::ip::tcp;
+
+/**
+ * @class ConnectionPool
+ * @brief Keeps established TLS streams alive between requests, grouped by (host, port).
+ *
+ * RestClient checks a stream out before sending a request and gives it back after a
+ * keep-alive response, so consecutive requests to the same server skip DNS, TCP connect
+ * and the TLS handshake.
+ */
+class ConnectionPool {
+public:
+    using Stream = beast::ssl_stream<beast::tcp_stream>;
+
+    /**
+     * @brief Constructs a ConnectionPool.
+     * @param ioc The Boost.Asio I/O context the streams are bound to.
+     * @param ctx The SSL context used for new streams.
+     * @param idle_timeout How long an unused stream is kept before it is dropped.
+     * @param max_idle_per_host Maximum number of idle streams kept for one (host, port).
+     */
+    ConnectionPool(net::io_context& ioc, ssl::context& ctx,
+                   std::chrono::seconds idle_timeout = std::chrono::seconds(30),
+                   std::size_t max_idle_per_host = 8);
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * @brief Takes an idle, still connected stream for the given server out of the pool.
+     * @param host The target host.
+     * @param port The target port.
+     * @return The stream or nullptr if there is no usable idle stream.
+     */
+    std::unique_ptr<Stream> acquire(const std::string& host, const std::string& port);
+
+    /**
+     * @brief Creates a new, not yet connected stream.
+     * @param host The target host (used for SNI).
+     * @return The new stream.
+     */
+    std::unique_ptr<Stream> create(const std::string& host);
+
+    /**
+     * @brief Returns a stream to the pool after a completed keep-alive exchange.
+     * @param host The target host.
+     * @param port The target port.
+     * @param stream The stream to keep.
+     */
+    void release(const std::string& host, const std::string& port, std::unique_ptr<Stream> stream);
+
+    /**
+     * @brief Drops all idle streams.
+     */
+    void clear();
+
+private:
+    /**
+     * @brief Idle stream together with the moment it was returned to the pool.
+     */
+    struct IdleStream {
+        std::unique_ptr<Stream> stream;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    net::io_context& ioc_;  ///< I/O context for new streams.
+    ssl::context& ctx_;  ///< SSL context for new streams.
+    std::chrono::seconds idle_timeout_;  ///< Maximum idle time of a pooled stream.
+    std::size_t max_idle_per_host_;  ///< Maximum number of idle streams per server.
+    std::map<std::string, std::deque<IdleStream>> idle_;  ///< Idle streams by "host:port".
+    std::mutex mutex_;  ///< Protects idle_.
+
+    /**
+     * @brief Checks that the peer has not closed an idle stream.
+     * @param stream The stream to check.
+     * @return true if the stream can be reused.
+     */
+    static bool isAlive(Stream& stream);
+
+    static std::string makeKey(const std::string& host, const std::string& port);
+};
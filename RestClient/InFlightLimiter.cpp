@@ -0,0 +1,22 @@
+#include "InFlightLimiter.h"
+#include <algorithm>
+
+InFlightLimiter::InFlightLimiter(std::size_t limit) : limit_(std::max<std::size_t>(limit, 1)) {}
+
+void InFlightLimiter::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return in_flight_ < limit_; });
+    ++in_flight_;
+}
+
+void InFlightLimiter::release() {
+    // Notify under the lock: the limiter may be destroyed as soon as wait() returns
+    std::lock_guard<std::mutex> lock(mutex_);
+    --in_flight_;
+    cv_.notify_all();
+}
+
+void InFlightLimiter::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return in_flight_ == 0; });
+}
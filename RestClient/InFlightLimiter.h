@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+/**
+ * @class InFlightLimiter
+ * @brief Bounds the number of asynchronous operations running at the same time.
+ *
+ * The producer calls acquire() before starting an operation, the completion handler calls
+ * release(), and wait() blocks until all started operations are finished.
+ */
+class InFlightLimiter {
+public:
+    /**
+     * @brief Constructs an InFlightLimiter.
+     * @param limit Maximum number of operations in flight (at least one).
+     */
+    explicit InFlightLimiter(std::size_t limit);
+
+    InFlightLimiter(const InFlightLimiter&) = delete;
+    InFlightLimiter& operator=(const InFlightLimiter&) = delete;
+
+    /**
+     * @brief Blocks until a slot is free and takes it.
+     */
+    void acquire();
+
+    /**
+     * @brief Frees a slot taken by acquire().
+     */
+    void release();
+
+    /**
+     * @brief Blocks until all taken slots are freed.
+     */
+    void wait();
+
+private:
+    std::size_t limit_;  ///< Maximum number of operations in flight.
+    std::size_t in_flight_ = 0;  ///< Number of operations in flight.
+    std::mutex mutex_;  ///< Protects in_flight_.
+    std::condition_variable cv_;  ///< Signals freed slots.
+};
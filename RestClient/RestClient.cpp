@@ -1,12 +1,31 @@
 #include "RestClient.h"
 #include <iostream>
+#include <limits>
 
-RestClient::RestClient(net::io_context& ioc, ssl::context& ctx, const std::string& host, const std::string& port)
-    : resolver_(ioc), stream_(ioc, ctx), host_(host), port_(port) {}
+RestClient::RestClient(net::io_context& ioc, ConnectionPool& pool, const std::string& host, const std::string& port,
+                       std::chrono::seconds timeout)
+    : resolver_(net::make_strand(ioc)), pool_(pool), host_(host), port_(port), timeout_(timeout) {}
 
 void RestClient::run(const std::string& target, http::verb method, 
                      const std::string& body, ResponseHandler handler,
                      const std::map<std::string, std::string>& headers) {
+    prepare(target, method, body, std::move(handler), headers);
+    start();
+}
+
+void RestClient::download(const std::string& target, const std::string& file_path,
+                          ResponseHandler handler, const std::map<std::string, std::string>& headers) {
+    prepare(target, http::verb::get, "", std::move(handler), headers);
+    file_path_ = file_path;
+
+    beast::error_code ec;
+    if (!open_file(ec)) return fail(ec, "open");
+
+    start();
+}
+
+void RestClient::prepare(const std::string& target, http::verb method, const std::string& body,
+                         ResponseHandler handler, const std::map<std::string, std::string>& headers) {
     req_.method(method);
     req_.target(target);
     req_.version(11);
@@ -29,15 +48,46 @@ void RestClient::run(const std::string& target, http::verb method,
     }
 
     response_handler_ = std::move(handler);
+}
+
+void RestClient::start() {
+    stream_ = pool_.acquire(host_, port_);
+    if (stream_) {
+        reused_ = true;
+        return send();
+    }
+
+    connect();
+}
+
+bool RestClient::open_file(beast::error_code& ec) {
+    file_parser_.emplace();
+    file_parser_->body_limit(std::numeric_limits<std::uint64_t>::max());
+    file_parser_->get().body().open(file_path_.c_str(), beast::file_mode::write, ec);
+
+    return !ec;
+}
+
+void RestClient::connect() {
+    reused_ = false;
+    stream_ = pool_.create(host_);
     resolver_.async_resolve(host_, port_, beast::bind_front_handler(&RestClient::on_resolve, shared_from_this()));
 }
 
+void RestClient::send() {
+    if (!file_parser_) parser_.emplace();
 
+    beast::get_lowest_layer(*stream_).expires_after(timeout_);
+    http::async_write(*stream_, req_,
+        std::bind(&RestClient::on_write, shared_from_this(),
+                  std::placeholders::_1, std::placeholders::_2));
+}
 
 void RestClient::on_resolve(beast::error_code ec, tcp::resolver::results_type results) {
     if (ec) return fail(ec, "resolve");
 
-    beast::get_lowest_layer(stream_).async_connect(results,
+    beast::get_lowest_layer(*stream_).expires_after(timeout_);
+    beast::get_lowest_layer(*stream_).async_connect(results,
         std::bind(&RestClient::on_connect, shared_from_this(),
                   std::placeholders::_1, std::placeholders::_2));
 }
@@ -45,48 +95,125 @@ void RestClient::on_resolve(beast::error_code ec, tcp::resolver::results_type re
 void RestClient::on_connect(beast::error_code ec, tcp::resolver::results_type::endpoint_type) {
     if (ec) return fail(ec, "connect");
 
-    stream_.async_handshake(ssl::stream_base::client,
+    beast::get_lowest_layer(*stream_).expires_after(timeout_);
+    stream_->async_handshake(ssl::stream_base::client,
         std::bind(&RestClient::on_handshake, shared_from_this(), std::placeholders::_1));
 }
 
 void RestClient::on_handshake(beast::error_code ec) {
     if (ec) return fail(ec, "handshake");
 
-    http::async_write(stream_, req_,
-        std::bind(&RestClient::on_write, shared_from_this(),
-                  std::placeholders::_1, std::placeholders::_2));
+    send();
 }
 
 void RestClient::on_write(beast::error_code ec, std::size_t bytes_transferred) {
-    if (ec) return fail(ec, "write");
-    boost::ignore_unused(bytes_transferred);
+    if (ec) return fail_or_reconnect(ec, "write", bytes_transferred == 0);
 
-    http::async_read(stream_, buffer_, res_,
-        std::bind(&RestClient::on_read, shared_from_this(),
-                  std::placeholders::_1, std::placeholders::_2));
+    read();
 }
 
-void RestClient::on_read(beast::error_code ec, std::size_t bytes_transferred) {
-    if (ec) return fail(ec, "read");
+void RestClient::read() {
+    // The deadline applies to every part of the response, so a long download is not cut off
+    beast::get_lowest_layer(*stream_).expires_after(timeout_);
+
+    auto handler = std::bind(&RestClient::on_read_some, shared_from_this(),
+                             std::placeholders::_1, std::placeholders::_2);
+
+    if (file_parser_) {
+        http::async_read_some(*stream_, buffer_, *file_parser_, std::move(handler));
+    } else {
+        http::async_read_some(*stream_, buffer_, *parser_, std::move(handler));
+    }
+}
+
+void RestClient::on_read_some(beast::error_code ec, std::size_t bytes_transferred) {
+    if (ec) return fail_or_reconnect(ec, "read", false);
     boost::ignore_unused(bytes_transferred);
 
-    int http_status = static_cast<int>(res_.result());
+    bool done = file_parser_ ? file_parser_->is_done() : parser_->is_done();
+    if (!done) return read();
+
+    on_read();
+}
+
+void RestClient::on_read() {
+    beast::error_code ec;
+
+    if (file_parser_) {
+        auto& response = file_parser_->get();
+        int http_status = static_cast<int>(response.result());
+        bool keep_alive = response.keep_alive();
+
+        response.body().close();
+
+        if (response_handler_) {
+            response_handler_("", ec, http_status, response.base());
+            response_handler_ = nullptr;
+        }
+
+        return finish(keep_alive);
+    }
+
+    auto& response = parser_->get();
+    int http_status = static_cast<int>(response.result());
+    bool keep_alive = response.keep_alive();
 
     if (response_handler_) {
-        response_handler_(boost::beast::buffers_to_string(res_.body().data()), ec, http_status);
+        response_handler_(boost::beast::buffers_to_string(response.body().data()), ec, http_status, response.base());
         response_handler_ = nullptr;
     }
 
-    stream_.async_shutdown([self = shared_from_this()](beast::error_code shutdown_ec) {
+    finish(keep_alive);
+}
+
+void RestClient::finish(bool keep_alive) {
+
+    if (keep_alive) {
+        pool_.release(host_, port_, std::move(stream_));
+        return;
+    }
+
+    beast::get_lowest_layer(*stream_).expires_after(timeout_);
+    stream_->async_shutdown([self = shared_from_this()](beast::error_code shutdown_ec) {
         if (shutdown_ec && shutdown_ec != beast::errc::not_connected && shutdown_ec != boost::asio::ssl::error::stream_truncated) {
             self->fail(shutdown_ec, "shutdown");
         }
     });
 }
 
+void RestClient::fail_or_reconnect(beast::error_code ec, const char* what, bool nothing_sent) {
+    // A connection dropped on the way without a reset shows as a timeout
+    bool lost = ec == http::error::end_of_stream || ec == net::error::eof ||
+                          ec == net::error::connection_reset || ec == net::error::broken_pipe ||
+                          ec == ssl::error::stream_truncated || ec == beast::error::timeout;
+
+    // The server may have applied a request it received before closing the connection
+    bool idempotent = req_.method() == http::verb::get || req_.method() == http::verb::head;
+
+    if (reused_ && lost && (idempotent || nothing_sent)) {
+        buffer_.consume(buffer_.size());
+
+        if (file_parser_) {
+            beast::error_code open_ec;
+            if (!open_file(open_ec)) return fail(open_ec, "open");
+        }
+
+        return connect();
+    }
+
+    fail(ec, what);
+}
+
 void RestClient::fail(beast::error_code ec, const char* what) {
     std::cerr << "RestClient fail:" << what << ": " << ec.message() << "\n";
+
+    if (file_parser_ && file_parser_->get().body().is_open()) {
+        file_parser_->get().body().close();
+    }
+
     if (response_handler_) {
-        response_handler_("", ec, 0);
+        auto handler = std::move(response_handler_);
+        response_handler_ = nullptr;
+        handler("", ec, 0, http::fields{});
     }
 }
\ No newline at end of file
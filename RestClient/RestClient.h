@@ -5,9 +5,14 @@
 #include <boost/beast/ssl.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+#include <chrono>
 #include <functional>
 #include <string>
 #include <map>
+#include <memory>
+#include <optional>
+
+#include "ConnectionPool.h"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -18,6 +23,11 @@ using tcp = net::ip::tcp;
 /**
  * @class RestClient
  * @brief Asynchronous REST client using Boost.Beast and Boost.Asio for HTTPS communication.
+ *
+ * The TLS stream is taken from a ConnectionPool and is given back after a keep-alive
+ * response, so a connection is reused by the next request to the same server. Every step
+ * (connect, handshake, write, each read of the response) must complete within the timeout,
+ * so a connection dropped silently by a firewall fails the request instead of hanging it.
  */
 class RestClient : public std::enable_shared_from_this<RestClient> {
 public:
@@ -26,17 +36,20 @@ public:
      * @param response_body The body of the HTTP response.
      * @param error_code The error code if an error occurred.
      * @param status_code The HTTP status code of the response.
+     * @param headers The header fields of the response (empty if no response was received).
      */
-    using ResponseHandler = std::function<void(const std::string&, const boost::system::error_code&, int)>;
+    using ResponseHandler = std::function<void(const std::string&, const boost::system::error_code&, int, const http::fields&)>;
 
     /**
      * @brief Constructs a RestClient instance.
      * @param ioc The Boost.Asio I/O context.
-     * @param ctx The SSL context.
+     * @param pool The pool of established connections.
      * @param host The target host.
      * @param port The target port.
+     * @param timeout Time the server may take to accept or send data before the request fails.
      */
-    RestClient(net::io_context& ioc, ssl::context& ctx, const std::string& host, const std::string& port);
+    RestClient(net::io_context& ioc, ConnectionPool& pool, const std::string& host, const std::string& port,
+               std::chrono::seconds timeout);
 
     /**
      * @brief Initiates an asynchronous HTTP request.
@@ -50,19 +63,57 @@ public:
              const std::string& body = "", ResponseHandler handler = nullptr,
              const std::map<std::string, std::string>& headers = {});
 
+    /**
+     * @brief Initiates an asynchronous GET request whose response body is written straight to a file.
+     *
+     * The body is streamed through a small buffer, so memory use does not depend on the size of
+     * the file, and no body size limit is applied. The handler receives an empty body string.
+     * @param target The target path on the server.
+     * @param file_path The file receiving the body (created or truncated).
+     * @param handler The callback function to handle the response.
+     * @param headers Additional headers to include in the request.
+     */
+    void download(const std::string& target, const std::string& file_path,
+                  ResponseHandler handler, const std::map<std::string, std::string>& headers = {});
+
 private:
     tcp::resolver resolver_;  ///< Resolves the target host and port.
-    beast::ssl_stream<beast::tcp_stream> stream_;  ///< Secure SSL stream.
+    ConnectionPool& pool_;  ///< Source of the established connections.
+    std::unique_ptr<ConnectionPool::Stream> stream_;  ///< Secure SSL stream.
+    bool reused_ = false;  ///< True if stream_ was taken from the pool.
     http::request<http::string_body> req_;  ///< HTTP request object.
-    http::response<http::dynamic_body> res_;  ///< HTTP response object.
+    std::optional<http::response_parser<http::dynamic_body>> parser_;  ///< Response parser (not of the download mode).
+    std::optional<http::response_parser<http::file_body>> file_parser_;  ///< Response parser of the download mode.
+    std::string file_path_;  ///< Destination file of the download mode.
     std::string host_, port_, target_;  ///< Connection parameters.
     ResponseHandler response_handler_;  ///< Callback handler for response processing.
     beast::flat_buffer buffer_;  ///< Buffer for storing received data.
+    std::chrono::seconds timeout_;  ///< Deadline of every connect, write and read.
 
+    void prepare(const std::string& target, http::verb method, const std::string& body,
+                 ResponseHandler handler, const std::map<std::string, std::string>& headers);
+    void start();
+    bool open_file(beast::error_code& ec);
+    void connect();
+    void send();
+    void read();
     void on_resolve(beast::error_code ec, tcp::resolver::results_type results);
     void on_connect(beast::error_code ec, tcp::resolver::results_type::endpoint_type);
     void on_handshake(beast::error_code ec);
     void on_write(beast::error_code ec, std::size_t bytes_transferred);
-    void on_read(beast::error_code ec, std::size_t bytes_transferred);
+    void on_read_some(beast::error_code ec, std::size_t bytes_transferred);
+    void on_read();
+    void finish(bool keep_alive);
     void fail(beast::error_code ec, const char* what);
+
+    /**
+     * @brief Handles a failure of a write or read operation.
+     *
+     * A pooled connection may have been closed by the server right before it was reused, or
+     * dropped silently on the way (which shows as a timeout). In this case a GET or HEAD
+     * request, or any request of which no byte was sent, is sent once more over a new
+     * connection; other requests fail, as the server may have applied them.
+     * @param nothing_sent True if the write failed before any byte of the request was sent.
+     */
+    void fail_or_reconnect(beast::error_code ec, const char* what, bool nothing_sent);
 };
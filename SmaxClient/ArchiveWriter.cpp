@@ -0,0 +1,317 @@
+#include "ArchiveWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef SMAX_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "EntityFileWriter.h"
+
+namespace smax_ns {
+
+namespace {
+
+/**
+ * @brief Writes a number as zero-padded octal followed by NUL, or in base-256 if it does not fit.
+ */
+void putNumber(char* field, std::size_t width, std::uint64_t value) {
+    std::uint64_t limit = std::uint64_t{1} << (3 * (width - 1));
+
+    if (value < limit) {
+        for (std::size_t i = width - 1; i-- > 0; value >>= 3) {
+            field[i] = static_cast<char>('0' + (value & 7));
+        }
+        field[width - 1] = '\0';
+        return;
+    }
+
+    for (std::size_t i = width; i-- > 1; value >>= 8) {
+        field[i] = static_cast<char>(value & 0xff);
+    }
+    field[0] = static_cast<char>(0x80);
+}
+
+} // namespace
+
+ArchiveWriter::ArchiveWriter(fs::path path)
+    : path_(std::move(path)),
+      compress_(isCompressedName(path_)),
+      mtime_(std::chrono::duration_cast<std::chrono::seconds>(
+          std::chrono::system_clock::now().time_since_epoch()).count()) {
+    if (compress_ && !supportsCompression()) {
+        throw std::runtime_error("Compressed archives need a build with WITH_ZSTD: " + path_.string());
+    }
+
+    if (path_.has_parent_path()) fs::create_directories(path_.parent_path());
+
+    out_.open(path_, std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("Could not create archive " + path_.string());
+    }
+
+#ifdef SMAX_WITH_ZSTD
+    if (compress_) {
+        zstd_ = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(zstd_, ZSTD_c_compressionLevel, COMPRESSION_LEVEL);
+        zstd_buffer_.resize(ZSTD_CStreamOutSize());
+    }
+#endif
+}
+
+ArchiveWriter::~ArchiveWriter() {
+    if (!finished_) finish();
+
+#ifdef SMAX_WITH_ZSTD
+    ZSTD_freeCCtx(zstd_);
+#endif
+}
+
+bool ArchiveWriter::supportsCompression() {
+#ifdef SMAX_WITH_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ArchiveWriter::isCompressedName(const fs::path& path) {
+    return path.extension() == ".zst";
+}
+
+bool ArchiveWriter::addMember(const std::string& id, const std::string& name, std::string_view data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    json entry = beginMember(name, data.size());
+    emit(data.data(), data.size());
+    endMember(data.size());
+
+    entry["id"] = id;
+    members_.push_back(std::move(entry));
+    ++member_count_;
+
+    return !failed_;
+}
+
+bool ArchiveWriter::addFile(const std::string& id, const std::string& name, const fs::path& source) {
+    std::error_code ec;
+    std::uint64_t size = fs::file_size(source, ec);
+    std::ifstream in(source, std::ios::binary);
+
+    if (ec || !in) {
+        std::cerr << "Error: Could not read " << source << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    json entry = beginMember(name, size);
+
+    // The header already announced the size, so a short read is padded to keep the archive valid
+    std::vector<char> buffer(64 * 1024);
+    std::uint64_t copied = 0;
+
+    while (copied < size) {
+        in.read(buffer.data(), static_cast<std::streamsize>(std::min<std::uint64_t>(buffer.size(), size - copied)));
+        std::size_t count = static_cast<std::size_t>(in.gcount());
+
+        if (count == 0) {
+            std::cerr << "Error: " << source << " is shorter than expected" << std::endl;
+            std::fill(buffer.begin(), buffer.end(), '\0');
+            while (copied < size) {
+                std::size_t gap = static_cast<std::size_t>(std::min<std::uint64_t>(buffer.size(), size - copied));
+                emit(buffer.data(), gap);
+                copied += gap;
+            }
+            failed_ = true;
+            break;
+        }
+
+        emit(buffer.data(), count);
+        copied += count;
+    }
+
+    endMember(size);
+
+    entry["id"] = id;
+    members_.push_back(std::move(entry));
+    ++member_count_;
+
+    return !failed_;
+}
+
+bool ArchiveWriter::finish(bool durable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (finished_) return !failed_;
+    finished_ = true;
+
+    // The index starts a frame of its own, so it can be read without the members before it
+    endFrame();
+
+    // The entries are moved into the index; member_count_ keeps their number
+    std::string index = json{{"members", std::move(members_)}}.dump();
+    json locator = beginMember("index.json", index.size());
+    emit(index.data(), index.size());
+    endMember(index.size());
+
+    std::uint64_t index_frame = frame_offset_;
+
+    std::string pointer = locator.dump();
+    beginMember("index.offset", pointer.size());
+    emit(pointer.data(), pointer.size());
+    endMember(pointer.size());
+
+    const char end_blocks[2 * BLOCK_SIZE] = {};
+    emit(end_blocks, sizeof(end_blocks));
+    endFrame();
+
+    if (compress_) {
+        char skippable[16];
+        const std::uint32_t magic = 0x184D2A5E;
+        const std::uint32_t length = 8;
+
+        for (int i = 0; i < 4; ++i) skippable[i] = static_cast<char>((magic >> (8 * i)) & 0xff);
+        for (int i = 0; i < 4; ++i) skippable[4 + i] = static_cast<char>((length >> (8 * i)) & 0xff);
+        for (int i = 0; i < 8; ++i) skippable[8 + i] = static_cast<char>((index_frame >> (8 * i)) & 0xff);
+
+        writeRaw(skippable, sizeof(skippable));
+    }
+
+    out_.close();
+    if (!out_) failed_ = true;
+
+    if (durable && !failed_) {
+        failed_ = !EntityFileWriter::syncPath(path_) ||
+                  !EntityFileWriter::syncPath(path_.has_parent_path() ? path_.parent_path() : fs::path("."));
+    }
+
+    if (failed_) std::cerr << "Error: Could not write archive " << path_ << std::endl;
+
+    return !failed_;
+}
+
+const fs::path& ArchiveWriter::getPath() const { return path_; }
+
+std::size_t ArchiveWriter::getMemberCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return member_count_;
+}
+
+json ArchiveWriter::beginMember(const std::string& name, std::uint64_t size) {
+    if (compress_ && tar_offset_ - frame_tar_offset_ >= FRAME_SIZE) endFrame();
+
+    writeHeader(name, size, '0');
+
+    json entry{{"name", name}, {"data", tar_offset_}, {"size", size}};
+    if (compress_) {
+        entry["frame"] = frame_offset_;
+        entry["frame_start"] = frame_tar_offset_;
+    }
+
+    return entry;
+}
+
+void ArchiveWriter::endMember(std::uint64_t size) {
+    const char padding[BLOCK_SIZE] = {};
+    std::size_t remainder = static_cast<std::size_t>(size % BLOCK_SIZE);
+
+    if (remainder != 0) emit(padding, BLOCK_SIZE - remainder);
+}
+
+void ArchiveWriter::writeHeader(const std::string& name, std::uint64_t size, char type) {
+    if (name.size() > 100) {
+        // pax record "<length> path=<name>\n", where length counts its own digits
+        std::string record = " path=" + name + "\n";
+        std::size_t length = record.size() + 1;
+        while (std::to_string(length).size() + record.size() != length) ++length;
+        record = std::to_string(length) + record;
+
+        writeHeader("PaxHeader/" + name.substr(name.size() - 90), record.size(), 'x');
+        emit(record.data(), record.size());
+        endMember(record.size());
+    }
+
+    char header[BLOCK_SIZE] = {};
+
+    std::memcpy(header, name.data(), std::min<std::size_t>(name.size(), 100));
+    putNumber(header + 100, 8, 0644);
+    putNumber(header + 108, 8, 0);
+    putNumber(header + 116, 8, 0);
+    putNumber(header + 124, 12, size);
+    putNumber(header + 136, 12, static_cast<std::uint64_t>(mtime_));
+    header[156] = type;
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+
+    // The checksum is computed with its own field filled with spaces
+    std::memset(header + 148, ' ', 8);
+    unsigned checksum = 0;
+    for (unsigned char c : header) checksum += c;
+    putNumber(header + 148, 7, checksum);
+
+    emit(header, sizeof(header));
+}
+
+void ArchiveWriter::emit(const char* data, std::size_t size) {
+    tar_offset_ += size;
+
+#ifdef SMAX_WITH_ZSTD
+    if (compress_) {
+        compress(data, size, ZSTD_e_continue);
+        return;
+    }
+#endif
+
+    writeRaw(data, size);
+}
+
+void ArchiveWriter::endFrame() {
+#ifdef SMAX_WITH_ZSTD
+    if (!compress_ || tar_offset_ == frame_tar_offset_) return;
+
+    compress(nullptr, 0, ZSTD_e_end);
+    frame_offset_ = file_offset_;
+    frame_tar_offset_ = tar_offset_;
+#endif
+}
+
+void ArchiveWriter::compress(const char* data, std::size_t size, int directive) {
+#ifdef SMAX_WITH_ZSTD
+    ZSTD_inBuffer input{data, size, 0};
+    auto mode = static_cast<ZSTD_EndDirective>(directive);
+
+    for (;;) {
+        ZSTD_outBuffer output{zstd_buffer_.data(), zstd_buffer_.size(), 0};
+        std::size_t remaining = ZSTD_compressStream2(zstd_, &output, &input, mode);
+
+        if (ZSTD_isError(remaining)) {
+            std::cerr << "Error: zstd: " << ZSTD_getErrorName(remaining) << std::endl;
+            failed_ = true;
+            return;
+        }
+
+        writeRaw(zstd_buffer_.data(), output.pos);
+
+        bool done = mode == ZSTD_e_continue ? input.pos == input.size : remaining == 0;
+        if (done) return;
+    }
+#else
+    (void)data;
+    (void)size;
+    (void)directive;
+#endif
+}
+
+void ArchiveWriter::writeRaw(const char* data, std::size_t size) {
+    out_.write(data, static_cast<std::streamsize>(size));
+    file_offset_ += size;
+
+    if (!out_) failed_ = true;
+}
+
+} // namespace smax_ns
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+struct ZSTD_CCtx_s;
+
+namespace smax_ns {
+
+/**
+ * @class ArchiveWriter
+ * @brief Streams output files into a single tar archive, optionally compressed with zstd.
+ *
+ * The archive is written sequentially; members may be added from several threads. A name
+ * ending in ".zst" selects compression, which needs a build with the CMake option WITH_ZSTD.
+ * Compressed archives are a sequence of zstd frames, a new one starting about every
+ * FRAME_SIZE bytes of tar data, so `zstd -d | tar -x` works and a member can be
+ * decompressed starting from its own frame.
+ *
+ * finish() appends the member "index.json":
+ *     {"members": [{"id", "name", "data", "size"[, "frame", "frame_start"]}, ...]}
+ * where data is the tar offset of the member's first byte, frame the file offset of the
+ * zstd frame holding it and frame_start the tar offset at which that frame begins. It is
+ * followed by the member "index.offset" holding {"data", "size"[, "frame", "frame_start"]}
+ * of index.json. In a plain archive the data of index.offset is the 512-byte block just
+ * before the two end-of-archive blocks; a compressed archive ends with a zstd skippable
+ * frame (magic 0x184D2A5E, 8-byte little-endian payload) holding the file offset of the
+ * frame that starts index.json.
+ */
+class ArchiveWriter {
+public:
+    /**
+     * @brief Creates the archive.
+     * @param path Archive file, replaced if it exists.
+     * @throws std::runtime_error if the file cannot be created or compression is not built in.
+     */
+    explicit ArchiveWriter(fs::path path);
+
+    /**
+     * @brief Finishes the archive if finish() was not called.
+     */
+    ~ArchiveWriter();
+
+    ArchiveWriter(const ArchiveWriter&) = delete;
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    /** @brief Checks whether the build supports compressed (.zst) archives. */
+    static bool supportsCompression();
+
+    /** @brief Checks whether an archive name selects compression. */
+    static bool isCompressedName(const fs::path& path);
+
+    /**
+     * @brief Adds a member from memory.
+     * @param id Id of the record the member belongs to.
+     * @param name Member name (relative path).
+     * @param data Member content.
+     * @return false if the archive could not be written.
+     */
+    bool addMember(const std::string& id, const std::string& name, std::string_view data);
+
+    /**
+     * @brief Adds a member from a file.
+     *
+     * The file is copied (and compressed) while the archive is locked, so this should not run
+     * on a thread other work waits for.
+     * @param id Id of the record the member belongs to.
+     * @param name Member name (relative path).
+     * @param source File copied into the archive.
+     * @return false if the file could not be read or the archive could not be written.
+     */
+    bool addFile(const std::string& id, const std::string& name, const fs::path& source);
+
+    /**
+     * @brief Writes the index and the end of the archive, and closes the file.
+     * @param durable fsync the archive and its folder.
+     * @return false if any member could not be written.
+     */
+    bool finish(bool durable = false);
+
+    /** @brief Retrieves the archive file. */
+    const fs::path& getPath() const;
+
+    /** @brief Retrieves the number of members added (the index excluded), also after finish(). */
+    std::size_t getMemberCount() const;
+
+private:
+    static constexpr std::size_t BLOCK_SIZE = 512;
+    static constexpr std::uint64_t FRAME_SIZE = 1 << 20;    ///< Tar bytes per zstd frame
+    static constexpr int COMPRESSION_LEVEL = 3;
+
+    fs::path path_;
+    std::ofstream out_;
+    bool compress_;
+    ZSTD_CCtx_s* zstd_ = nullptr;
+    std::vector<char> zstd_buffer_;
+    mutable std::mutex mutex_;              ///< Serializes members
+    std::uint64_t tar_offset_ = 0;          ///< Tar bytes written
+    std::uint64_t file_offset_ = 0;         ///< Bytes written to the file
+    std::uint64_t frame_offset_ = 0;        ///< File offset of the current zstd frame
+    std::uint64_t frame_tar_offset_ = 0;    ///< Tar offset at which the current zstd frame begins
+    std::int64_t mtime_;                    ///< Modification time of all members
+    json members_ = json::array();          ///< Index entries (moved into the index by finish())
+    std::size_t member_count_ = 0;          ///< Number of members added
+    bool failed_ = false;
+    bool finished_ = false;
+
+    /**
+     * @brief Starts a member: starts a new frame if the current one is full, writes the
+     * header(s) and returns the index entry.
+     */
+    json beginMember(const std::string& name, std::uint64_t size);
+
+    /**
+     * @brief Pads the member data to a whole block.
+     */
+    void endMember(std::uint64_t size);
+
+    /**
+     * @brief Writes one ustar header block, preceded by a pax header for names over 100 bytes.
+     */
+    void writeHeader(const std::string& name, std::uint64_t size, char type);
+
+    /**
+     * @brief Writes tar bytes, compressing them if needed.
+     */
+    void emit(const char* data, std::size_t size);
+
+    /**
+     * @brief Ends the current zstd frame (no-op for plain archives).
+     */
+    void endFrame();
+
+    /**
+     * @brief Writes compressor input with the given ZSTD_EndDirective.
+     */
+    void compress(const char* data, std::size_t size, int directive);
+
+    /**
+     * @brief Writes bytes to the file.
+     */
+    void writeRaw(const char* data, std::size_t size);
+};
+
+} // namespace smax_ns
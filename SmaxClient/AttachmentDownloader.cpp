@@ -0,0 +1,156 @@
+#include "AttachmentDownloader.h"
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#include "../RestClient/InFlightLimiter.h"
+
+namespace smax_ns {
+
+AttachmentDownloader::AttachmentDownloader(Fetch fetch, std::size_t parallelism)
+    : fetch_(std::move(fetch)), parallelism_(std::max<std::size_t>(parallelism, 1)) {}
+
+DownloadSummary AttachmentDownloader::run(const std::vector<DownloadJob>& jobs) {
+    DownloadSummary summary;
+    summary.total = jobs.size();
+
+    std::mutex mutex;
+    InFlightLimiter limiter(parallelism_);
+
+    // Appending to the archive (copying and compressing) or hashing and linking a saved file
+    // reads the whole file; it runs here so the I/O threads keep receiving the other downloads
+    boost::asio::thread_pool workers(parallelism_);
+
+    auto complete = [&](const DownloadJob& job, const fs::path& part_path, const RestResponse& response) {
+        std::uintmax_t size = 0;
+        bool saved = response.success && response.status_code == 200 &&
+                     (archive_ ? commitMember(part_path, job, size) : commitFile(part_path, job.file_path, size));
+
+        if (saved && !archive_) catalogFile(job);
+
+        if (!saved || archive_) {
+            std::error_code remove_ec;
+            fs::remove(part_path, remove_ec);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (saved) {
+                ++summary.succeeded;
+                summary.bytes += size;
+                std::ostringstream line;
+                line << "File is saved: " << (archive_ ? fs::path(job.member_name) : job.file_path) << "\n";
+                std::cout << line.str();
+            } else {
+                ++summary.failed;
+                std::cerr << "File load error: " << job.url << " (HTTP " << response.status_code << ")\n";
+            }
+        }
+
+        limiter.release();
+    };
+
+    auto started = std::chrono::steady_clock::now();
+
+    for (const auto& job : jobs) {
+        limiter.acquire();
+
+        fs::path part_path = job.file_path;
+        part_path += ".part";
+
+        std::error_code ec;
+        fs::create_directories(job.file_path.parent_path(), ec);
+
+        fetch_(job.url, part_path.string(),
+            [&, job, part_path](RestResponse response) {
+                boost::asio::post(workers, [&complete, job, part_path, response = std::move(response)]() {
+                    complete(job, part_path, response);
+                });
+            });
+    }
+
+    limiter.wait();
+    workers.join();
+
+    summary.elapsed = std::chrono::steady_clock::now() - started;
+    return summary;
+}
+
+void AttachmentDownloader::setArchive(ArchiveWriter* archive) {
+    archive_ = archive;
+}
+
+void AttachmentDownloader::setManifest(AttachmentManifest* manifest) {
+    manifest_ = manifest;
+}
+
+void AttachmentDownloader::setStore(AttachmentStore* store) {
+    store_ = store;
+}
+
+std::string AttachmentDownloader::formatSummary(const DownloadSummary& summary) {
+    double seconds = std::chrono::duration<double>(summary.elapsed).count();
+    double megabytes = static_cast<double>(summary.bytes) / (1024.0 * 1024.0);
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2)
+        << "Files saved: " << summary.succeeded << " of " << summary.total
+        << ", failed: " << summary.failed
+        << ", " << megabytes << " MB in " << seconds << " s";
+
+    if (seconds > 0) {
+        oss << " (" << megabytes / seconds << " MB/s, " << summary.succeeded / seconds << " files/s)";
+    }
+
+    return oss.str();
+}
+
+bool AttachmentDownloader::commitFile(const fs::path& part_path, const fs::path& file_path, std::uintmax_t& size) {
+    std::error_code ec;
+
+    size = fs::file_size(part_path, ec);
+    if (ec) {
+        std::cerr << "File creation error: " << file_path << "\n";
+        return false;
+    }
+
+    fs::rename(part_path, file_path, ec);
+    if (ec) {
+        std::cerr << "File creation error: " << file_path << " (" << ec.message() << ")\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool AttachmentDownloader::commitMember(const fs::path& part_path, const DownloadJob& job, std::uintmax_t& size) const {
+    std::error_code ec;
+
+    size = fs::file_size(part_path, ec);
+    if (ec || !archive_->addFile(job.record_id, job.member_name, part_path)) {
+        std::cerr << "Archive error: " << job.member_name << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+void AttachmentDownloader::catalogFile(const DownloadJob& job) const {
+    if (!manifest_ && !store_) return;
+
+    std::string digest;
+    if (!AttachmentManifest::hashFile(job.file_path, digest)) {
+        std::cerr << "Could not hash " << job.file_path << "\n";
+        return;
+    }
+
+    if (store_) store_->add(job.file_path, digest);
+    if (manifest_) manifest_->record(job.attachment_id, job.last_update_time, job.file_path, digest);
+}
+
+} // namespace smax_ns
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../RestClient/AsyncRuntime.h"
+#include "ArchiveWriter.h"
+#include "AttachmentManifest.h"
+#include "AttachmentStore.h"
+
+namespace fs = std::filesystem;
+
+namespace smax_ns {
+
+/**
+ * @brief A single file to be downloaded.
+ */
+struct DownloadJob {
+    std::string url;     ///< FRS URL of the file
+    fs::path file_path;  ///< Destination file (the temporary file with an archive)
+    std::string record_id;   ///< Id of the record owning the file (archive index)
+    std::string member_name; ///< Archive member name
+    std::string attachment_id;          ///< Id of the attachment (manifest)
+    std::int64_t last_update_time = 0;  ///< LastUpdateTime of the attachment (manifest)
+};
+
+/**
+ * @brief Aggregate result of a download batch.
+ */
+struct DownloadSummary {
+    std::size_t total = 0;      ///< Number of files in the batch
+    std::size_t succeeded = 0;  ///< Number of saved files
+    std::size_t failed = 0;     ///< Number of files that were not saved
+    std::uintmax_t bytes = 0;   ///< Number of saved bytes
+    std::chrono::steady_clock::duration elapsed{}; ///< Wall time of the batch
+};
+
+/**
+ * @class AttachmentDownloader
+ * @brief Downloads a batch of files keeping up to N requests in flight.
+ *
+ * Response bodies are streamed into "<file>.part" through a fixed-size buffer, so memory use
+ * does not depend on the file size. A complete file is handed to a pool of worker threads,
+ * which renames it to the final name (or appends it to the archive), hashes it for the
+ * manifest and links it into the store, so the I/O threads only receive data. A failed file
+ * is reported and does not stop the rest of the batch.
+ */
+class AttachmentDownloader {
+public:
+    /**
+     * @brief Starts the download of a file into file_path; the callback runs on one of the I/O threads.
+     */
+    using Fetch = std::function<void(const std::string& target, const std::string& file_path, AsyncRuntime::Callback callback)>;
+
+    /**
+     * @brief Constructs an AttachmentDownloader.
+     * @param fetch Sends the requests, adding the authorization of the moment.
+     * @param parallelism Maximum number of requests in flight.
+     */
+    AttachmentDownloader(Fetch fetch, std::size_t parallelism);
+
+    /**
+     * @brief Downloads all files and blocks until the last one is finished.
+     * @param jobs Files to download.
+     * @return Aggregate result.
+     */
+    DownloadSummary run(const std::vector<DownloadJob>& jobs);
+
+    /**
+     * @brief Adds the downloaded files to an archive instead of keeping them.
+     *
+     * Each file is downloaded completely to its file_path (a staging file), then appended to
+     * the archive as member_name on a worker thread and removed; the archive is written
+     * sequentially, so concurrent downloads cannot be streamed into it directly.
+     * @param archive The archive, which must outlive run().
+     */
+    void setArchive(ArchiveWriter* archive);
+
+    /**
+     * @brief Records every saved file in a manifest.
+     * @param manifest The manifest, which must outlive run().
+     */
+    void setManifest(AttachmentManifest* manifest);
+
+    /**
+     * @brief Adds every saved file to a content store.
+     * @param store The store, which must outlive run().
+     */
+    void setStore(AttachmentStore* store);
+
+    /**
+     * @brief Formats a summary as a human readable line.
+     * @param summary The summary.
+     * @return The text.
+     */
+    static std::string formatSummary(const DownloadSummary& summary);
+
+private:
+    Fetch fetch_;
+    std::size_t parallelism_;
+    ArchiveWriter* archive_ = nullptr;
+    AttachmentManifest* manifest_ = nullptr;
+    AttachmentStore* store_ = nullptr;
+
+    /**
+     * @brief Moves a completely downloaded file to its destination.
+     * @param part_path Downloaded file.
+     * @param file_path Destination file.
+     * @param size Receives the file size.
+     * @return true on success.
+     */
+    static bool commitFile(const fs::path& part_path, const fs::path& file_path, std::uintmax_t& size);
+
+    /**
+     * @brief Appends a completely downloaded file to the archive.
+     * @param part_path Downloaded file.
+     * @param job The job.
+     * @param size Receives the file size.
+     * @return true on success.
+     */
+    bool commitMember(const fs::path& part_path, const DownloadJob& job, std::uintmax_t& size) const;
+
+    /**
+     * @brief Hashes a saved file once for the manifest and the store.
+     */
+    void catalogFile(const DownloadJob& job) const;
+};
+
+} // namespace smax_ns
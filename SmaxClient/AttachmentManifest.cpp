@@ -0,0 +1,128 @@
+#include "AttachmentManifest.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <openssl/evp.h>
+
+namespace smax_ns {
+
+AttachmentManifest::AttachmentManifest(fs::path folder)
+    : folder_(std::move(folder)), path_(folder_ / "manifest.json") {
+    std::ifstream in(path_);
+    if (!in) return;
+
+    try {
+        json loaded = json::parse(in);
+        if (loaded.is_object()) entries_ = std::move(loaded);
+    } catch (const json::exception& e) {
+        // Everything is downloaded again and the manifest rebuilt
+        std::cerr << "Manifest " << path_ << " is ignored: " << e.what() << std::endl;
+    }
+}
+
+bool AttachmentManifest::isCurrent(const Attachment& attachment, const fs::path& file_path) const {
+    // Without LastUpdateTime a change cannot be detected
+    if (attachment.last_update_time == 0) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = entries_.find(attachment.id);
+    if (it == entries_.end() || !it->is_object()) return false;
+
+    const json& entry = *it;
+    std::uint64_t size = entry.value("size", std::uint64_t{0});
+
+    if (entry.value("LastUpdateTime", std::int64_t{0}) != attachment.last_update_time) return false;
+    if (attachment.size != 0 && size != attachment.size) return false;
+    if (entry.value("path", "") != file_path.lexically_relative(folder_).generic_string()) return false;
+
+    std::error_code ec;
+    return fs::file_size(file_path, ec) == size && !ec;
+}
+
+bool AttachmentManifest::record(const std::string& attachment_id, std::int64_t last_update_time, const fs::path& file_path,
+                                const std::string& digest) {
+    std::error_code ec;
+    std::uintmax_t size = fs::file_size(file_path, ec);
+
+    if (ec) {
+        std::cerr << "Manifest: could not read " << file_path << std::endl;
+        return false;
+    }
+
+    json entry = {
+        {"path", file_path.lexically_relative(folder_).generic_string()},
+        {"size", size},
+        {"LastUpdateTime", last_update_time},
+        {"sha256", digest}
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[attachment_id] = std::move(entry);
+
+    return true;
+}
+
+bool AttachmentManifest::save() const {
+    fs::path tmp_path = path_;
+    tmp_path += ".tmp";
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        out << entries_.dump(1) << '\n';
+        out.close();
+
+        if (!out) {
+            std::cerr << "Error: Could not write manifest " << tmp_path << std::endl;
+            return false;
+        }
+    }
+
+    // A crash leaves either the old or the new manifest
+    std::error_code ec;
+    fs::rename(tmp_path, path_, ec);
+    if (ec) {
+        std::cerr << "Error: Could not write manifest " << path_ << " (" << ec.message() << ")" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+const fs::path& AttachmentManifest::getPath() const { return path_; }
+
+bool AttachmentManifest::hashFile(const fs::path& file_path, std::string& digest) {
+    std::ifstream in(file_path, std::ios::binary);
+    if (!in) return false;
+
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    if (!ctx || EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) != 1) return false;
+
+    std::vector<char> buffer(64 * 1024);
+    while (in) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if (in.gcount() > 0) EVP_DigestUpdate(ctx.get(), buffer.data(), static_cast<std::size_t>(in.gcount()));
+    }
+    if (in.bad()) return false;
+
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    if (EVP_DigestFinal_ex(ctx.get(), hash, &length) != 1) return false;
+
+    std::ostringstream oss;
+    for (unsigned int i = 0; i < length; ++i) {
+        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    }
+
+    digest = oss.str();
+    return true;
+}
+
+} // namespace smax_ns
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+
+#include "EmbeddedJsonReader.h"
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+/**
+ * @class AttachmentManifest
+ * @brief Records the attachments already downloaded into an attachment folder.
+ *
+ * The manifest is "manifest.json" in the attachment folder:
+ *     {"<attachment id>": {"path", "size", "LastUpdateTime", "sha256"}, ...}
+ * where path is relative to the folder. An attachment is unchanged if its entry has the
+ * size and LastUpdateTime EMS reports now and the file still has that size. Entries of
+ * attachments not seen by a run are kept, so runs with different filters share a manifest.
+ */
+class AttachmentManifest {
+public:
+    /**
+     * @brief Loads the manifest of a folder; a missing or unreadable manifest is empty.
+     * @param folder The attachment folder.
+     */
+    explicit AttachmentManifest(fs::path folder);
+
+    AttachmentManifest(const AttachmentManifest&) = delete;
+    AttachmentManifest& operator=(const AttachmentManifest&) = delete;
+
+    /**
+     * @brief Checks whether an attachment was downloaded to a file and has not changed since.
+     * @param attachment The attachment as reported by EMS.
+     * @param file_path Destination of the attachment.
+     * @return false if the attachment must be downloaded.
+     */
+    bool isCurrent(const Attachment& attachment, const fs::path& file_path) const;
+
+    /**
+     * @brief Records a downloaded file.
+     * @param attachment_id Id of the attachment.
+     * @param last_update_time LastUpdateTime reported by EMS.
+     * @param file_path The downloaded file.
+     * @param digest SHA-256 of the file (see hashFile()).
+     * @return false if the file could not be read.
+     */
+    bool record(const std::string& attachment_id, std::int64_t last_update_time, const fs::path& file_path,
+                const std::string& digest);
+
+    /**
+     * @brief Replaces the manifest file.
+     * @return false if it could not be written.
+     */
+    bool save() const;
+
+    /** @brief Retrieves the manifest file. */
+    const fs::path& getPath() const;
+
+    /**
+     * @brief Computes the SHA-256 of a file.
+     * @param file_path The file.
+     * @param digest Receives the digest as lowercase hex.
+     * @return false if the file could not be read.
+     */
+    static bool hashFile(const fs::path& file_path, std::string& digest);
+
+private:
+    fs::path folder_;
+    fs::path path_;
+    json entries_ = json::object();
+    mutable std::mutex mutex_;      ///< Serializes record() calls of the download threads
+};
+
+} // namespace smax_ns
@@ -0,0 +1,95 @@
+#include "AttachmentStore.h"
+
+#include <iostream>
+
+namespace smax_ns {
+
+AttachmentStore::AttachmentStore(const fs::path& folder) : blobs_(folder / ".blobs") {}
+
+bool AttachmentStore::add(const fs::path& file_path, const std::string& digest) {
+    fs::path blob = blobs_ / digest.substr(0, 2) / digest;
+    std::error_code ec;
+
+    // Two threads may finish files with the same content at the same time
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!fs::exists(blob, ec)) {
+        fs::create_directories(blob.parent_path(), ec);
+        fs::create_hard_link(file_path, blob, ec);
+
+        if (ec) {
+            std::cerr << "Store: " << file_path << " is kept as a copy (" << ec.message() << ")\n";
+            return false;
+        }
+        return true;
+    }
+
+    if (fs::equivalent(blob, file_path, ec)) return true;
+
+    std::uintmax_t size = fs::file_size(file_path, ec);
+    if (ec || !replaceByLink(blob, file_path)) return false;
+
+    ++linked_count_;
+    saved_bytes_ += size;
+    return true;
+}
+
+bool AttachmentStore::duplicate(const fs::path& source, const fs::path& target, bool link) {
+    std::error_code ec;
+
+    std::uintmax_t size = fs::file_size(source, ec);
+    if (ec) {
+        std::cerr << "File creation error: " << target << " (" << source << " is missing)\n";
+        return false;
+    }
+
+    // A link to the source, or a copy made after the source was last written, is up to date
+    std::error_code target_ec;
+    if (fs::equivalent(source, target, target_ec)) return true;
+    if (fs::file_size(target, target_ec) == size && !target_ec &&
+        fs::last_write_time(target, target_ec) >= fs::last_write_time(source, ec) && !target_ec && !ec) {
+        return true;
+    }
+
+    fs::create_directories(target.parent_path(), ec);
+    if (link && replaceByLink(source, target)) return true;
+
+    fs::copy_file(source, target, fs::copy_options::overwrite_existing, ec);
+    if (ec) {
+        std::cerr << "File creation error: " << target << " (" << ec.message() << ")\n";
+        return false;
+    }
+
+    return true;
+}
+
+std::size_t AttachmentStore::getLinkedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return linked_count_;
+}
+
+std::uintmax_t AttachmentStore::getSavedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return saved_bytes_;
+}
+
+bool AttachmentStore::replaceByLink(const fs::path& source, const fs::path& target) {
+    fs::path link_path = target;
+    link_path += ".link";
+
+    // The link is renamed over the target, so the target is never missing
+    std::error_code ec;
+    fs::remove(link_path, ec);
+    fs::create_hard_link(source, link_path, ec);
+    if (ec) return false;
+
+    fs::rename(link_path, target, ec);
+    if (ec) {
+        fs::remove(link_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace smax_ns
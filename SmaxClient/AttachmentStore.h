@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace smax_ns {
+
+/**
+ * @class AttachmentStore
+ * @brief Keeps one copy of every distinct file content in an attachment folder.
+ *
+ * Contents are stored as ".blobs/<2 hex digits>/<sha256>" in the folder, and the files of
+ * the records are hard links to them, so a logo attached to a thousand records uses the
+ * disk space of one file. Hard links share their content: a file edited in place changes
+ * every record having that content. If a link cannot be created (another file system, a
+ * file system without hard links, the link limit reached), the file is kept as a copy.
+ */
+class AttachmentStore {
+public:
+    /**
+     * @brief Constructs an AttachmentStore.
+     * @param folder The attachment folder.
+     */
+    explicit AttachmentStore(const fs::path& folder);
+
+    AttachmentStore(const AttachmentStore&) = delete;
+    AttachmentStore& operator=(const AttachmentStore&) = delete;
+
+    /**
+     * @brief Adds a downloaded file to the store.
+     *
+     * If the content is already stored the file is replaced by a link to it, otherwise the
+     * file becomes the stored copy.
+     * @param file_path The file.
+     * @param digest SHA-256 of the file as lowercase hex.
+     * @return false if the file was left out of the store.
+     */
+    bool add(const fs::path& file_path, const std::string& digest);
+
+    /**
+     * @brief Makes a file have the content of another one.
+     *
+     * Nothing is done if the target is a link to the source, or a copy of the same size
+     * written after the source.
+     * @param source An existing file.
+     * @param target The file to create or replace.
+     * @param link Create a hard link (falling back to a copy) instead of a copy.
+     * @return false if the target could not be created.
+     */
+    static bool duplicate(const fs::path& source, const fs::path& target, bool link);
+
+    /** @brief Retrieves the number of files replaced by a link to a stored copy. */
+    std::size_t getLinkedCount() const;
+
+    /** @brief Retrieves the number of bytes these files no longer take up. */
+    std::uintmax_t getSavedBytes() const;
+
+private:
+    fs::path blobs_;
+    mutable std::mutex mutex_;          ///< Serializes add() of the download threads
+    std::size_t linked_count_ = 0;
+    std::uintmax_t saved_bytes_ = 0;
+
+    /**
+     * @brief Replaces a file by a hard link to another one.
+     * @return false if the link could not be created; the file is then unchanged.
+     */
+    static bool replaceByLink(const fs::path& source, const fs::path& target);
+};
+
+} // namespace smax_ns
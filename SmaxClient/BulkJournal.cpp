@@ -0,0 +1,195 @@
+#include "BulkJournal.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+namespace fs = std::filesystem;
+
+BulkJournal::BulkJournal(const std::string& csv, const std::string& entity, const std::string& operation, bool resume)
+    : path_(pathFor(csv)) {
+    std::error_code ec;
+    std::uintmax_t csv_size = fs::file_size(csv, ec);
+    if (ec) csv_size = 0;
+
+    // An edited file of the same size has another modification time
+    auto csv_time = fs::last_write_time(csv, ec);
+    std::int64_t csv_mtime = ec ? 0 : static_cast<std::int64_t>(csv_time.time_since_epoch().count());
+
+    bool cut_off = false;
+
+    if (resume && fs::exists(path_)) {
+        load(csv_size, csv_mtime, entity, operation);
+
+        // The last line of a crashed run may lack its line break
+        std::ifstream in(path_, std::ios::binary | std::ios::ate);
+        if (in && in.tellg() > 0) {
+            in.seekg(-1, std::ios::end);
+            cut_off = in.get() != '\n';
+        }
+    }
+
+    out_.open(path_, resume ? std::ios::app : std::ios::trunc);
+    if (!out_) {
+        throw std::runtime_error("ERROR opening journal: " + path_);
+    }
+
+    if (cut_off) out_ << '\n';
+
+    json start = {
+        {"type", "start"},
+        {"csv", csv},
+        {"csv_size", csv_size},
+        {"csv_mtime", csv_mtime},
+        {"entity", entity},
+        {"operation", operation},
+        {"resume", resume},
+        {"time", std::chrono::duration_cast<std::chrono::seconds>(
+                     std::chrono::system_clock::now().time_since_epoch()).count()}
+    };
+
+    out_ << start.dump() << '\n';
+    out_.flush();
+}
+
+void BulkJournal::load(std::uintmax_t csv_size, std::int64_t csv_mtime, const std::string& entity, const std::string& operation) {
+    std::ifstream in(path_);
+    if (!in) {
+        throw std::runtime_error("ERROR opening journal: " + path_);
+    }
+
+    struct BatchEnd {
+        std::size_t last_row;
+        std::size_t end;
+    };
+
+    std::vector<BatchEnd> batch_ends;
+    std::string line;
+    std::size_t line_number = 0;
+
+    while (std::getline(in, line)) {
+        ++line_number;
+        if (line.empty()) continue;
+
+        // A line damaged by a crash is skipped; the batch it describes is simply sent again
+        json record = json::parse(line, nullptr, false);
+        if (!record.is_object()) {
+            std::cerr << "Journal " << path_ << ": ignoring damaged line " << line_number << std::endl;
+            continue;
+        }
+
+        try {
+            const std::string type = record.value("type", "");
+
+            if (type == "start") {
+                if (record.value("entity", "") != entity || record.value("operation", "") != operation ||
+                    record.value("csv_size", std::uintmax_t{0}) != csv_size ||
+                    record.value("csv_mtime", std::int64_t{0}) != csv_mtime) {
+                    throw std::runtime_error("Journal " + path_ + " belongs to another run (entity, operation or CSV file differ)");
+                }
+                continue;
+            }
+
+            if (type != "batch") continue;
+
+            const json& rows = record["rows"];
+            const json& ids = record["ids"];
+            if (!rows.is_array() || !ids.is_array() || rows.empty()) continue;
+
+            // The line is checked completely before any of its records is taken
+            bool unknown = record.value("unknown", false);
+            std::vector<std::size_t> accepted;
+            std::vector<std::size_t> unknown_rows;
+            for (std::size_t i = 0; i < rows.size() && i < ids.size(); ++i) {
+                if (!ids[i].is_null()) accepted.push_back(rows[i].get<std::size_t>());
+                else if (unknown) unknown_rows.push_back(rows[i].get<std::size_t>());
+            }
+
+            std::optional<BatchEnd> batch_end;
+            if (record.contains("end")) {
+                batch_end = BatchEnd{rows.back().get<std::size_t>(), record["end"].get<std::size_t>()};
+            }
+
+            for (std::size_t row : accepted) {
+                if (row >= confirmed_.size()) confirmed_.resize(row + 1, false);
+                if (!confirmed_[row]) {
+                    confirmed_[row] = true;
+                    ++confirmed_count_;
+                }
+            }
+
+            // Sending these again could create their records twice
+            for (std::size_t row : unknown_rows) {
+                if (row >= confirmed_.size()) confirmed_.resize(row + 1, false);
+                if (!confirmed_[row]) {
+                    confirmed_[row] = true;
+                    ++unknown_count_;
+                }
+            }
+
+            if (batch_end) batch_ends.push_back(*batch_end);
+        } catch (const json::exception&) {
+            std::cerr << "Journal " << path_ << ": ignoring damaged line " << line_number << std::endl;
+        }
+    }
+
+    // Every record before the first unconfirmed one can be skipped without reading it
+    std::size_t first_open = 2;
+    while (isConfirmed(first_open)) ++first_open;
+
+    for (const auto& batch : batch_ends) {
+        if (batch.last_row < first_open && batch.last_row + 1 > resume_row_) {
+            resume_row_ = batch.last_row + 1;
+            resume_offset_ = batch.end;
+        }
+    }
+}
+
+bool BulkJournal::isConfirmed(std::size_t row) const {
+    return row < confirmed_.size() && confirmed_[row];
+}
+
+std::size_t BulkJournal::getConfirmedCount() const { return confirmed_count_; }
+
+std::size_t BulkJournal::getUnknownCount() const { return unknown_count_; }
+
+std::size_t BulkJournal::getResumeOffset() const { return resume_offset_; }
+
+std::size_t BulkJournal::getResumeRow() const { return resume_row_; }
+
+void BulkJournal::recordBatch(const BulkBatch& batch, const std::vector<std::optional<std::string>>& ids, bool unknown) {
+    json record = {
+        {"type", "batch"},
+        {"batch", batch.index},
+        {"rows", batch.rows},
+        {"ids", json::array()}
+    };
+
+    // Resent entities are not a contiguous part of the CSV file
+    if (batch.end > 0) {
+        record["begin"] = batch.begin;
+        record["end"] = batch.end;
+    }
+
+    for (const auto& id : ids) {
+        record["ids"].push_back(id ? json(*id) : json(nullptr));
+    }
+
+    if (unknown) record["unknown"] = true;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    out_ << record.dump() << '\n';
+    out_.flush();
+}
+
+const std::string& BulkJournal::getPath() const { return path_; }
+
+std::string BulkJournal::pathFor(const std::string& csv) { return csv + ".journal"; }
+
+} // namespace smax_ns
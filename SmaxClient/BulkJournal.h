@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace smax_ns {
+
+/**
+ * @brief Rows of the CSV file sent in one bulk request.
+ */
+struct BulkBatch {
+    std::size_t index = 0;            ///< Sequence number of the batch in the run
+    std::vector<std::size_t> rows;    ///< Record numbers of the entities in the batch
+    std::size_t begin = 0;            ///< Offset of the first record in the CSV file
+    std::size_t end = 0;              ///< Offset right behind the last record (0 for resent entities)
+};
+
+/**
+ * @class BulkJournal
+ * @brief Append-only checkpoint journal of a bulk CREATE/UPDATE.
+ *
+ * The journal is a JSON-lines file next to the CSV file. Every answered batch appends one
+ * line with its record numbers, file offsets and the Ids assigned by the server (null for
+ * rejected entities). A request of unknown outcome (a CREATE the server may have applied) is
+ * marked as such. A resumed run skips the confirmed records and the ones of unknown outcome,
+ * and starts reading the CSV file behind the last batch that has no unconfirmed record before it.
+ */
+class BulkJournal {
+public:
+    /**
+     * @brief Opens the journal.
+     * @param csv Name of the CSV file.
+     * @param entity Entity type of the run.
+     * @param operation Bulk operation of the run.
+     * @param resume Load the existing journal and append to it (otherwise a new journal is started).
+     * @throws std::runtime_error If the journal cannot be opened or belongs to another run
+     * (other entity type or operation, or a CSV file of another size or modification time).
+     */
+    BulkJournal(const std::string& csv, const std::string& entity, const std::string& operation, bool resume);
+
+    BulkJournal(const BulkJournal&) = delete;
+    BulkJournal& operator=(const BulkJournal&) = delete;
+
+    /**
+     * @brief Checks whether a record was accepted by a previous run, or may have been.
+     * @param row Record number.
+     * @return true if the record must not be sent again.
+     */
+    bool isConfirmed(std::size_t row) const;
+
+    /** @brief Retrieves the number of records confirmed by previous runs. */
+    std::size_t getConfirmedCount() const;
+
+    /** @brief Retrieves the number of records of previous runs with an unknown outcome. */
+    std::size_t getUnknownCount() const;
+
+    /** @brief Retrieves the offset in the CSV file to continue reading from (0 starts from the beginning). */
+    std::size_t getResumeOffset() const;
+
+    /** @brief Retrieves the record number at the resume offset. */
+    std::size_t getResumeRow() const;
+
+    /**
+     * @brief Appends an answered batch.
+     * @param batch The batch.
+     * @param ids Id assigned to each entity of the batch (nullopt if the entity was rejected).
+     * @param unknown The request got no readable answer and may have been applied.
+     */
+    void recordBatch(const BulkBatch& batch, const std::vector<std::optional<std::string>>& ids, bool unknown = false);
+
+    /** @brief Retrieves the journal file name. */
+    const std::string& getPath() const;
+
+    /**
+     * @brief Builds the journal file name of a CSV file.
+     * @param csv Name of the CSV file.
+     * @return "<csv>.journal".
+     */
+    static std::string pathFor(const std::string& csv);
+
+private:
+    std::string path_;                  ///< Journal file name
+    std::ofstream out_;                 ///< Journal opened for appending
+    std::mutex mutex_;                  ///< Serializes appends
+    std::vector<bool> confirmed_;       ///< Records not to be sent again by record number
+    std::size_t confirmed_count_ = 0;   ///< Number of confirmed records
+    std::size_t unknown_count_ = 0;     ///< Number of records with an unknown outcome
+    std::size_t resume_offset_ = 0;     ///< Offset to continue reading from
+    std::size_t resume_row_ = 0;        ///< Record number at resume_offset_
+
+    /**
+     * @brief Loads the confirmed records of an existing journal.
+     *
+     * Lines that cannot be read (e.g. the last line of a crashed run) are skipped.
+     * @param csv_size Size of the CSV file the journal must belong to.
+     * @param csv_mtime Modification time of the CSV file the journal must belong to.
+     * @param entity Entity type the journal must belong to.
+     * @param operation Bulk operation the journal must belong to.
+     */
+    void load(std::uintmax_t csv_size, std::int64_t csv_mtime, const std::string& entity, const std::string& operation);
+};
+
+} // namespace smax_ns
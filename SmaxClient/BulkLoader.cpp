@@ -0,0 +1,397 @@
+#include "BulkLoader.h"
+
+#include <algorithm>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+
+namespace smax_ns {
+
+namespace {
+
+// Delay before the first retry; doubled with every further attempt
+constexpr std::chrono::milliseconds RETRY_DELAY{500};
+
+} // namespace
+
+BulkLoader::BulkLoader(boost::asio::io_context& io, Sender sender, std::string operation, std::size_t batch_size,
+                       std::size_t concurrency, std::size_t max_retries)
+    : io_(io), sender_(std::move(sender)), operation_(operation), batch_size_(batch_size),
+      concurrency_(std::max<std::size_t>(concurrency, 1)), max_retries_(max_retries),
+      idempotent_(operation != "CREATE"), writer_(std::move(operation)), limiter_(concurrency_) {}
+
+void BulkLoader::add(const ParsedRow& row) {
+    if (journal_ && journal_->isConfirmed(row.number)) return;
+
+    // The server would reject the whole batch, or store garbled text
+    if (!row.valid) {
+        ++entity_count_;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        rejects_.push_back(Reject{row.number, std::string(row.raw)});
+        invalid_results_.push_back({
+            {"completion_status", "FAILED"},
+            {"errorDetails", {{"message", "The record is not valid UTF-8 and was not sent; save the CSV file as UTF-8"},
+                              {"row", row.number}}}
+        });
+        return;
+    }
+
+    if (pending_.items.empty()) pending_.begin = row.offset;
+    pending_.end = row.offset + row.raw.size();
+    pending_.items.push_back(Item{row.number, row.entity, std::string(row.raw)});
+
+    writer_.addEntity(row.entity);
+    ++entity_count_;
+
+    if (batch_size_ != 0 && writer_.getEntityCount() >= batch_size_) {
+        flush();
+    }
+}
+
+void BulkLoader::setJournal(BulkJournal* journal) { journal_ = journal; }
+
+void BulkLoader::setRejectFile(std::string path, std::string header) {
+    reject_path_ = std::move(path);
+    reject_header_ = std::move(header);
+}
+
+void BulkLoader::flush() {
+    if (writer_.getEntityCount() == 0) return;
+
+    std::size_t batch = batch_count_++;
+    std::vector<std::size_t> positions(pending_.items.size());
+    std::iota(positions.begin(), positions.end(), 0);
+
+    pending_.results.resize(pending_.items.size());
+    pending_.outstanding = 1;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_.push_back(std::move(pending_));
+    }
+    pending_ = Slot{};
+
+    limiter_.acquire();
+
+    dispatch(batch, std::move(positions), 0, writer_.finish());
+
+    // The sender has copied the body into the request, so the buffer can be reused
+    writer_.begin();
+}
+
+void BulkLoader::dispatch(std::size_t batch, std::vector<std::size_t> positions, std::size_t attempt,
+                          const std::string& body) {
+    // Once the server refused the credentials it would refuse every further request too
+    if (int status = refused_status_.load(); status != 0) {
+        RestResponse refused{true, "Not sent: a bulk request was refused with HTTP " + std::to_string(status), status, "", ""};
+        boost::asio::post(io_, [this, batch, positions = std::move(positions), attempt, refused]() {
+            onResponse(batch, positions, attempt, refused);
+        });
+        return;
+    }
+
+    sender_(body, [this, batch, positions = std::move(positions), attempt](RestResponse response) {
+        onResponse(batch, positions, attempt, response);
+    });
+}
+
+void BulkLoader::resend(std::size_t batch, std::vector<std::size_t> positions, std::size_t attempt,
+                        std::chrono::milliseconds delay) {
+    auto send = [this, batch, positions = std::move(positions), attempt]() mutable {
+        Slot* slot;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot = &slots_[batch];
+        }
+
+        // The items of a batch are not touched until all its requests are answered
+        BulkBodyWriter writer(operation_, 0);
+        for (std::size_t position : positions) {
+            writer.addEntity(slot->items[position].entity);
+        }
+
+        dispatch(batch, std::move(positions), attempt, writer.finish());
+    };
+
+    if (delay.count() == 0) {
+        send();
+        return;
+    }
+
+    auto timer = std::make_shared<boost::asio::steady_timer>(io_, delay);
+    timer->async_wait([timer, send = std::move(send)](const boost::system::error_code&) mutable { send(); });
+}
+
+void BulkLoader::onResponse(std::size_t batch, const std::vector<std::size_t>& positions, std::size_t attempt,
+                            const RestResponse& response) {
+    json result = parseBatchResult(batch, response);
+
+    Slot* slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot = &slots_[batch];
+    }
+
+    std::vector<std::optional<std::string>> ids(positions.size());
+    std::vector<json> outcomes(positions.size());       // final results; null while the entity is resent
+    std::vector<std::size_t> retry;                     // positions failed with a retryable status
+    std::vector<std::vector<std::size_t>> halves;       // parts of a rejected request
+    bool unknown = false;                               // the request may have been applied
+
+    json* list = nullptr;
+    if (result.is_object() && result.contains("entity_result_list") && result["entity_result_list"].is_array() &&
+        result["entity_result_list"].size() == positions.size()) {
+        list = &result["entity_result_list"];
+    }
+
+    if (list) {
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            json& entry = (*list)[i];
+            ids[i] = acceptedId(entry);
+
+            if (ids[i]) {
+                outcomes[i] = std::move(entry);
+                continue;
+            }
+
+            int status = 400;
+            if (entry.is_object() && entry.contains("errorDetails") && entry["errorDetails"].is_object()) {
+                status = entry["errorDetails"].value("httpStatus", 400);
+            }
+
+            if (isRetryable(status) && attempt < max_retries_) {
+                retry.push_back(positions[i]);
+            } else {
+                outcomes[i] = std::move(entry);
+            }
+        }
+    } else {
+        // Nothing is known about the single entities of the request
+        int status = response.success ? response.status_code : 0;
+
+        // Without a readable answer the server may have applied the request; sending a CREATE
+        // again would duplicate its records
+        bool maybe_applied = status == 0 || status == 200 || status >= 500;
+
+        if ((status == 429 || (maybe_applied && idempotent_)) && attempt < max_retries_) {
+            retry = positions;
+        } else if (isValidationError(status) && positions.size() > 1) {
+            std::size_t middle = positions.size() / 2;
+            halves.emplace_back(positions.begin(), positions.begin() + middle);
+            halves.emplace_back(positions.begin() + middle, positions.end());
+        } else {
+            if (status == 401 || status == 403) {
+                int none = 0;
+                if (refused_status_.compare_exchange_strong(none, status)) {
+                    std::cerr << "Bulk batch " << batch << ": refused with HTTP " << status
+                              << ", the remaining batches are not sent" << std::endl;
+                }
+            }
+
+            unknown = maybe_applied && !idempotent_;
+
+            json error = {
+                {"httpStatus", response.status_code},
+                {"message", unknown ? "Outcome unknown, check whether the record exists before loading it again: " + response.body
+                                    : response.body}
+            };
+
+            for (auto& outcome : outcomes) {
+                outcome = {{"completion_status", unknown ? "UNKNOWN" : "FAILED"}, {"errorDetails", error}};
+            }
+        }
+    }
+
+    if (journal_) {
+        BulkBatch record;
+        record.index = batch;
+
+        for (std::size_t position : positions) {
+            record.rows.push_back(slot->items[position].row);
+        }
+
+        // Only the first request of a batch covers a contiguous part of the CSV file
+        if (attempt == 0 && positions.size() == slot->items.size()) {
+            record.begin = slot->begin;
+            record.end = slot->end;
+        }
+
+        journal_->recordBatch(record, ids, unknown);
+    }
+
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            if (outcomes[i].is_null()) continue;
+
+            const Item& item = slot->items[positions[i]];
+
+            if (!ids[i]) {
+                if (outcomes[i].is_object() && outcomes[i].contains("errorDetails") &&
+                    outcomes[i]["errorDetails"].is_object()) {
+                    outcomes[i]["errorDetails"]["batch"] = batch;
+                    outcomes[i]["errorDetails"]["row"] = item.row;
+                }
+
+                // A record that may exist already must not be loaded again from the reject file
+                if (unknown) {
+                    ++unknown_count_;
+                } else {
+                    rejects_.push_back(Reject{item.row, item.raw});
+                }
+                slot->failed = true;
+            }
+
+            slot->results[positions[i]] = std::move(outcomes[i]);
+        }
+
+        resent_count_ += retry.size();
+        for (const auto& half : halves) resent_count_ += half.size();
+
+        slot->outstanding += (retry.empty() ? 0 : 1) + halves.size();
+        done = --slot->outstanding == 0;
+
+        if (done) {
+            slot->items.clear();
+            slot->items.shrink_to_fit();
+        }
+    }
+
+    if (!retry.empty()) {
+        resend(batch, std::move(retry), attempt + 1, RETRY_DELAY * (1 << std::min<std::size_t>(attempt, 10)));
+    }
+
+    for (auto& half : halves) {
+        resend(batch, std::move(half), attempt, std::chrono::milliseconds(0));
+    }
+
+    if (done) limiter_.release();
+}
+
+json BulkLoader::finish() {
+    flush();
+    limiter_.wait();
+
+    json report = {
+        {"entity_result_list", json::array()},
+        {"meta", {
+            {"completion_status", "OK"},
+            {"errorDetailsList", json::array()}
+        }}
+    };
+
+    auto& results = report["entity_result_list"];
+    auto& errors = report["meta"]["errorDetailsList"];
+
+    for (auto& slot : slots_) {
+        if (slot.failed) ++failed_batch_count_;
+
+        for (auto& result : slot.results) {
+            if (result.value("completion_status", "") != "OK" && result.contains("errorDetails")) {
+                errors.push_back(result["errorDetails"]);
+            }
+            results.push_back(std::move(result));
+        }
+    }
+
+    for (auto& result : invalid_results_) {
+        errors.push_back(result["errorDetails"]);
+        results.push_back(std::move(result));
+    }
+
+    if (!rejects_.empty() || unknown_count_ > 0) {
+        report["meta"]["completion_status"] = "FAILED";
+    }
+
+    report["meta"]["total_count"] = entity_count_;
+    report["meta"]["skipped_count"] = journal_ ? journal_->getConfirmedCount() : 0;
+    report["meta"]["batch_count"] = batch_count_;
+    report["meta"]["failed_batch_count"] = failed_batch_count_;
+    report["meta"]["resent_count"] = resent_count_;
+    report["meta"]["rejected_count"] = rejects_.size();
+    report["meta"]["unknown_count"] = unknown_count_;
+
+    if (writeRejects()) {
+        report["meta"]["reject_file"] = reject_path_;
+    }
+
+    return report;
+}
+
+std::size_t BulkLoader::getBatchCount() const { return batch_count_; }
+
+std::size_t BulkLoader::getFailedBatchCount() const { return failed_batch_count_; }
+
+std::size_t BulkLoader::getRejectedCount() const { return rejects_.size(); }
+
+std::size_t BulkLoader::getUnknownCount() const { return unknown_count_; }
+
+bool BulkLoader::isRetryable(int status) {
+    return status == 0 || status == 429 || status >= 500;
+}
+
+bool BulkLoader::isValidationError(int status) {
+    return status == 400 || status == 409 || status == 413 || status == 422;
+}
+
+bool BulkLoader::writeRejects() {
+    if (reject_path_.empty()) return false;
+
+    if (rejects_.empty()) {
+        // A reject file of an earlier run would be mistaken for the result of this one
+        std::error_code ec;
+        std::filesystem::remove(reject_path_, ec);
+        return false;
+    }
+
+    std::sort(rejects_.begin(), rejects_.end(), [](const Reject& a, const Reject& b) { return a.row < b.row; });
+
+    std::ofstream out(reject_path_, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "ERROR opening reject file: " << reject_path_ << std::endl;
+        return false;
+    }
+
+    out << reject_header_ << '\n';
+    for (const auto& reject : rejects_) {
+        out << reject.raw << '\n';
+    }
+
+    return static_cast<bool>(out);
+}
+
+json BulkLoader::parseBatchResult(std::size_t batch, const RestResponse& response) {
+    if (!response.success || response.status_code != 200) return nullptr;
+
+    try {
+        json result = json::parse(response.body);
+        if (result.is_object()) return result;
+    } catch (const json::exception& e) {
+        std::cerr << "Bulk batch " << batch << ": JSON parsing error: " << e.what() << std::endl;
+    }
+
+    return nullptr;
+}
+
+std::optional<std::string> BulkLoader::acceptedId(const json& entry) {
+    if (!entry.is_object() || entry.value("completion_status", "") != "OK") return std::nullopt;
+
+    if (entry.contains("entity") && entry["entity"].is_object() &&
+        entry["entity"].contains("properties") && entry["entity"]["properties"].is_object() &&
+        entry["entity"]["properties"].contains("Id")) {
+        const json& id = entry["entity"]["properties"]["Id"];
+        if (id.is_string()) return id.get<std::string>();
+        if (!id.is_null()) return id.dump();
+    }
+
+    return std::string();
+}
+
+} // namespace smax_ns
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../RestClient/AsyncRuntime.h"
+#include "../RestClient/InFlightLimiter.h"
+#include "../Parser/BulkBodyWriter.h"
+#include "../Parser/Parser.h"
+#include "BulkJournal.h"
+
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+/**
+ * @class BulkLoader
+ * @brief Splits a bulk CREATE/UPDATE into batches and posts them with bounded parallelism.
+ *
+ * Entities are added one by one; a batch is sent as soon as it is full, so only the batches
+ * in flight are kept in memory.
+ *
+ * Failed entities are handled per entity instead of per batch:
+ * - entities the server reports as failed with a retryable status (429, 5xx) are sent again in
+ *   a smaller batch after a growing delay;
+ * - a request answered with 429, or an UPDATE request without a readable answer (transport
+ *   error, 5xx, unreadable result), is sent again the same way;
+ * - a CREATE request without a readable answer is not sent again, as the server may have
+ *   created its records; its entities are reported with completion_status UNKNOWN and
+ *   recorded as such in the journal, so a resumed run does not send them either;
+ * - a batch rejected as a whole with a validation error (400, 409, 413, 422) is split in
+ *   halves until the offending entities are isolated;
+ * - after 401 or 403 the remaining batches are not sent;
+ * - entities that still fail are reported and their CSV records are written to the reject file;
+ * - records that are not valid UTF-8 are not sent at all, but reported and rejected the same way.
+ *
+ * The results are combined into one report of the same shape as a single /ems/bulk response:
+ * entity_result_list in the original order (followed by the records that are not valid UTF-8)
+ * and meta with the overall completion_status and the errorDetailsList entries of the failed
+ * entities.
+ */
+class BulkLoader {
+public:
+    /**
+     * @brief Function posting one bulk body; the callback receives the response.
+     */
+    using Sender = std::function<void(const std::string& body, AsyncRuntime::Callback callback)>;
+
+    /**
+     * @brief Constructs a BulkLoader.
+     * @param io I/O context running the retry timers.
+     * @param sender Posts a bulk body to the server.
+     * @param operation Bulk operation (CREATE or UPDATE).
+     * @param batch_size Number of entities per batch (0 sends everything in one batch).
+     * @param concurrency Maximum number of batches in flight.
+     * @param max_retries Number of times an entity failed with a retryable status is sent again.
+     */
+    BulkLoader(boost::asio::io_context& io, Sender sender, std::string operation, std::size_t batch_size,
+               std::size_t concurrency, std::size_t max_retries);
+
+    /**
+     * @brief Adds an entity; sends the current batch when it is full.
+     *
+     * Blocks while the maximum number of batches is in flight. Rows confirmed by the
+     * journal of a previous run are skipped.
+     * @param row The parsed row.
+     */
+    void add(const ParsedRow& row);
+
+    /**
+     * @brief Records every answered request in a journal and skips the rows it confirms.
+     * @param journal The journal (not owned; nullptr disables journaling).
+     */
+    void setJournal(BulkJournal* journal);
+
+    /**
+     * @brief Writes the records of permanently failed entities to a CSV file.
+     *
+     * The file gets the header of the source file and the failed records in file order, so it
+     * can be corrected and loaded again. It is removed when no entity fails.
+     * @param path Name of the reject file.
+     * @param header Header record of the source file.
+     */
+    void setRejectFile(std::string path, std::string header);
+
+    /**
+     * @brief Sends the last batch and blocks until all batches (and their retries) are answered.
+     * @return Combined report.
+     */
+    json finish();
+
+    /** @brief Retrieves the number of sent batches (without retries). */
+    std::size_t getBatchCount() const;
+
+    /** @brief Retrieves the number of batches with permanently failed entities. */
+    std::size_t getFailedBatchCount() const;
+
+    /** @brief Retrieves the number of permanently failed entities. */
+    std::size_t getRejectedCount() const;
+
+    /** @brief Retrieves the number of entities of CREATE requests with an unknown outcome. */
+    std::size_t getUnknownCount() const;
+
+    /**
+     * @brief Checks whether a status is worth sending the same entities again.
+     * @param status HTTP status (0 for a transport error).
+     * @return true for transport errors, 429 and 5xx.
+     */
+    static bool isRetryable(int status);
+
+    /**
+     * @brief Checks whether a request rejected as a whole may be accepted in smaller parts.
+     * @param status HTTP status.
+     * @return true for validation errors (400, 409, 413, 422).
+     */
+    static bool isValidationError(int status);
+
+private:
+    /**
+     * @brief An entity waiting for its final result.
+     */
+    struct Item {
+        std::size_t row;        ///< Record number in the CSV file
+        std::string entity;     ///< JSON text of the entity
+        std::string raw;        ///< CSV record as written in the file
+    };
+
+    /**
+     * @brief State of one batch until all its entities have a final result.
+     */
+    struct Slot {
+        std::vector<Item> items;            ///< Entities of the batch (released when done)
+        std::vector<json> results;          ///< Final result of each entity
+        std::size_t begin = 0;              ///< Offset of the first record in the CSV file
+        std::size_t end = 0;                ///< Offset right behind the last record
+        std::size_t outstanding = 0;        ///< Requests in flight for the batch
+        bool failed = false;                ///< At least one entity failed permanently
+    };
+
+    /**
+     * @brief A failed CSV record.
+     */
+    struct Reject {
+        std::size_t row;
+        std::string raw;
+    };
+
+    boost::asio::io_context& io_;
+    Sender sender_;
+    std::string operation_;
+    std::size_t batch_size_;
+    std::size_t concurrency_;
+    std::size_t max_retries_;
+    bool idempotent_;                            ///< Requests can be sent again (UPDATE, not CREATE)
+    std::size_t batch_count_ = 0;
+    std::size_t failed_batch_count_ = 0;
+    std::size_t entity_count_ = 0;
+    std::size_t resent_count_ = 0;               ///< Entities sent again (retries and split batches)
+    std::size_t unknown_count_ = 0;              ///< Entities of CREATE requests with an unknown outcome
+    std::atomic<int> refused_status_{0};         ///< 401 or 403 once the server refused the credentials
+    BulkBodyWriter writer_;                      ///< Body of the batch being filled
+    Slot pending_;                               ///< Entities of the batch being filled
+    BulkJournal* journal_ = nullptr;             ///< Checkpoint journal (optional)
+    std::string reject_path_;                    ///< Reject file (empty disables it)
+    std::string reject_header_;                  ///< Header record of the reject file
+    std::deque<Slot> slots_;                     ///< Sent batches (stable references)
+    std::vector<Reject> rejects_;                ///< Permanently failed records
+    std::vector<json> invalid_results_;          ///< Results of the records that are not valid UTF-8 (never sent)
+    std::mutex mutex_;                           ///< Protects slots_, rejects_, invalid_results_, resent_count_ and unknown_count_
+    InFlightLimiter limiter_;                    ///< Bounds the batches in flight
+
+    /**
+     * @brief Sends the current batch.
+     */
+    void flush();
+
+    /**
+     * @brief Posts entities of a batch.
+     * @param batch Batch index.
+     * @param positions Positions of the entities in the batch.
+     * @param attempt Number of the attempt (0 for the first request).
+     * @param body Request body.
+     */
+    void dispatch(std::size_t batch, std::vector<std::size_t> positions, std::size_t attempt, const std::string& body);
+
+    /**
+     * @brief Posts entities of a batch again, optionally after a delay.
+     * @param batch Batch index.
+     * @param positions Positions of the entities in the batch.
+     * @param attempt Number of the attempt.
+     * @param delay Delay before sending.
+     */
+    void resend(std::size_t batch, std::vector<std::size_t> positions, std::size_t attempt,
+                std::chrono::milliseconds delay);
+
+    /**
+     * @brief Distributes the response of a request over the entities it contained.
+     * @param batch Batch index.
+     * @param positions Positions of the entities in the batch.
+     * @param attempt Number of the attempt.
+     * @param response The response.
+     */
+    void onResponse(std::size_t batch, const std::vector<std::size_t>& positions, std::size_t attempt,
+                    const RestResponse& response);
+
+    /**
+     * @brief Writes the reject file.
+     * @return true if the file was written.
+     */
+    bool writeRejects();
+
+    /**
+     * @brief Parses the response of a request.
+     * @param batch Batch index.
+     * @param response The response.
+     * @return The /ems/bulk result, or null if the request was rejected.
+     */
+    static json parseBatchResult(std::size_t batch, const RestResponse& response);
+
+    /**
+     * @brief Extracts the Id assigned to an accepted entity.
+     * @param entry Entry of entity_result_list.
+     * @return The Id, or nullopt if the entity was not accepted.
+     */
+    static std::optional<std::string> acceptedId(const json& entry);
+};
+
+} // namespace smax_ns
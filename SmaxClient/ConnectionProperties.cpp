@@ -58,6 +58,10 @@ ConnectionParameters& ConnectionParameters::getInstance() {
     return *instance_;
 }
 
+std::unique_ptr<ConnectionParameters> ConnectionParameters::create(const InputValues& input_values) {
+    return std::unique_ptr<ConnectionParameters>(new ConnectionParameters(input_values));
+}
+
 ConnectionParameters::ConnectionParameters(const InputValues& input_values)
     : protocol_(input_values.protocol),
       host_(input_values.host),
@@ -79,7 +83,31 @@ ConnectionParameters::ConnectionParameters(const InputValues& input_values)
       json_action_output_folder_(input_values.json_action_output_folder),
       att_action_output_(input_values.att_action_output),
       att_action_field_(input_values.att_action_field),
-      att_action_output_folder_(input_values.att_action_output_folder) {}
+      att_action_output_folder_(input_values.att_action_output_folder),
+      io_threads_(input_values.io_threads),
+      request_timeout_(input_values.request_timeout),
+      att_parallelism_(input_values.att_parallelism),
+      att_refresh_(input_values.att_refresh),
+      att_dedup_(input_values.att_dedup),
+      page_size_(input_values.page_size),
+      page_concurrency_(input_values.page_concurrency),
+      bulk_batch_size_(input_values.bulk_batch_size),
+      bulk_concurrency_(input_values.bulk_concurrency),
+      csv_threads_(input_values.csv_threads),
+      resume_(input_values.resume),
+      bulk_retries_(input_values.bulk_retries),
+      output_format_(input_values.output_format),
+      output_file_(input_values.output_file),
+      since_state_(input_values.since_state),
+      cache_ttl_(input_values.cache_ttl),
+      cache_entries_(input_values.cache_entries),
+      token_cache_(input_values.token_cache),
+      json_write_threads_(input_values.json_write_threads),
+      json_max_outstanding_(input_values.json_max_outstanding),
+      json_compact_(input_values.json_compact),
+      json_durable_(input_values.json_durable),
+      output_layout_(input_values.output_layout),
+      output_archive_(input_values.output_archive) {}
 
 const std::string& ConnectionParameters::getProtocol() const { return protocol_; }
 const std::string& ConnectionParameters::getHost() const { return host_; }
@@ -102,6 +130,31 @@ const std::string& ConnectionParameters::getJsonActionOutputFolder() const { ret
 const std::shared_ptr<std::vector<std::string>>& ConnectionParameters::getJsonActionFieldsList() const { return json_action_fields_list_; }
 const std::string& ConnectionParameters::getAttActionOutput() const { return att_action_output_; }
 const std::string& ConnectionParameters::getAttActionField() const { return att_action_field_; }
-const std::string& ConnectionParameters::getAttActionOutputFolder() const { return att_action_output_folder_; }    
+const std::string& ConnectionParameters::getAttActionOutputFolder() const { return att_action_output_folder_; }
+std::size_t ConnectionParameters::getIoThreads() const { return io_threads_; }
+
+std::size_t ConnectionParameters::getRequestTimeout() const { return request_timeout_; }
+std::size_t ConnectionParameters::getAttParallelism() const { return att_parallelism_; }
+bool ConnectionParameters::isAttRefresh() const { return att_refresh_; }
+bool ConnectionParameters::isAttDedup() const { return att_dedup_; }
+std::size_t ConnectionParameters::getPageSize() const { return page_size_; }
+std::size_t ConnectionParameters::getPageConcurrency() const { return page_concurrency_; }
+std::size_t ConnectionParameters::getBulkBatchSize() const { return bulk_batch_size_; }
+std::size_t ConnectionParameters::getBulkConcurrency() const { return bulk_concurrency_; }
+std::size_t ConnectionParameters::getCsvThreads() const { return csv_threads_; }
+bool ConnectionParameters::isResume() const { return resume_; }
+std::size_t ConnectionParameters::getBulkRetries() const { return bulk_retries_; }
+const std::string& ConnectionParameters::getOutputFormat() const { return output_format_; }
+const std::string& ConnectionParameters::getOutputFile() const { return output_file_; }
+const std::string& ConnectionParameters::getSinceState() const { return since_state_; }
+std::size_t ConnectionParameters::getCacheTtl() const { return cache_ttl_; }
+std::size_t ConnectionParameters::getCacheEntries() const { return cache_entries_; }
+const std::string& ConnectionParameters::getTokenCache() const { return token_cache_; }
+std::size_t ConnectionParameters::getJsonWriteThreads() const { return json_write_threads_; }
+std::size_t ConnectionParameters::getJsonMaxOutstanding() const { return json_max_outstanding_; }
+bool ConnectionParameters::isJsonCompact() const { return json_compact_; }
+bool ConnectionParameters::isJsonDurable() const { return json_durable_; }
+const std::string& ConnectionParameters::getOutputLayout() const { return output_layout_; }
+const std::string& ConnectionParameters::getOutputArchive() const { return output_archive_; }
 
 } // namespace smax_ns
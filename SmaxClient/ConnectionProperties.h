@@ -52,6 +52,34 @@ struct InputValues {
     std::string att_action_output;  ///< Output method for attachments (file or console)
     std::string att_action_field;   ///< Attachment action field name
     std::string att_action_output_folder; ///< Folder for storing attachment outputs
+    std::size_t io_threads;         ///< Number of threads running network I/O
+    std::size_t request_timeout;    ///< Seconds the server may take to accept or send data
+    std::size_t att_parallelism;    ///< Number of attachment downloads in flight
+    bool att_refresh;               ///< Download attachments even if the manifest shows them unchanged
+    bool att_dedup;                 ///< Hard link attachment files with the same content to one stored copy
+    std::size_t page_size;          ///< Number of records per EMS page (0 disables paging)
+    std::size_t page_concurrency;   ///< Number of EMS pages fetched in parallel
+    std::size_t bulk_batch_size;    ///< Number of entities per bulk request (0 sends one request)
+    std::size_t bulk_concurrency;   ///< Number of bulk requests in flight
+    std::size_t csv_threads;        ///< Number of threads parsing the CSV file
+    bool resume;                    ///< Resume a bulk load from its journal
+    std::size_t bulk_retries;       ///< Number of times a bulk entity failed with a retryable status is resent
+    std::string output_format;      ///< Format of GET results (pretty, json or ndjson)
+    std::string output_file;        ///< File receiving GET results (empty for the console)
+    std::string since_state;        ///< State file of incremental runs (LastUpdateTime watermark)
+    std::size_t cache_ttl;          ///< Seconds an EMS response is used without a request (0 disables the cache)
+    std::size_t cache_entries;      ///< Number of EMS responses cached in memory
+    std::string token_cache;        ///< File keeping tokens between runs (empty to authenticate every run)
+    std::string jobs;               ///< JSON-lines file of jobs run in this process (--jobs)
+    std::size_t jobs_concurrency;   ///< Number of jobs running at the same time
+    std::string serve;              ///< Address of the local query API (--serve), "<address>:<port>"
+    bool serve_remote;              ///< Allow --serve on an address other than loopback
+    std::size_t json_write_threads; ///< Number of threads writing JSON action files
+    std::size_t json_max_outstanding; ///< Maximum number of JSON action files queued or being written
+    bool json_compact;              ///< Write JSON action files without indentation
+    bool json_durable;              ///< fsync JSON action files and their folder
+    std::string output_layout;      ///< Folder layout of per-record output (flat, prefix or hash)
+    std::string output_archive;     ///< Tar archive receiving JSON action files and attachments
 };
 
 /**
@@ -73,6 +101,13 @@ public:
      */
     static ConnectionParameters& getInstance();
 
+    /**
+     * @brief Creates an instance independent of the singleton (one per job of --jobs).
+     * @param input_values The input values to initialize the instance.
+     * @return The new instance.
+     */
+    static std::unique_ptr<ConnectionParameters> create(const InputValues& input_values);
+
     /** @brief Retrieves the protocol. */
     const std::string& getProtocol() const;
     /** @brief Retrieves the host. */
@@ -117,6 +152,54 @@ public:
     const std::string& getAttActionField() const;
     /** @brief Retrieves the attachment action output folder. */
     const std::string& getAttActionOutputFolder() const;
+    /** @brief Retrieves the number of network I/O threads. */
+    std::size_t getIoThreads() const;
+    /** @brief Retrieves the seconds the server may take to accept or send data. */
+    std::size_t getRequestTimeout() const;
+    /** @brief Retrieves the number of attachment downloads in flight. */
+    std::size_t getAttParallelism() const;
+    /** @brief Checks whether attachments are downloaded even if the manifest shows them unchanged. */
+    bool isAttRefresh() const;
+    /** @brief Checks whether attachment files with the same content are linked to one stored copy. */
+    bool isAttDedup() const;
+    /** @brief Retrieves the number of records per EMS page. */
+    std::size_t getPageSize() const;
+    /** @brief Retrieves the number of EMS pages fetched in parallel. */
+    std::size_t getPageConcurrency() const;
+    /** @brief Retrieves the number of entities per bulk request. */
+    std::size_t getBulkBatchSize() const;
+    /** @brief Retrieves the number of bulk requests in flight. */
+    std::size_t getBulkConcurrency() const;
+    /** @brief Retrieves the number of threads parsing the CSV file. */
+    std::size_t getCsvThreads() const;
+    /** @brief Checks whether a bulk load resumes from its journal. */
+    bool isResume() const;
+    /** @brief Retrieves the number of times a bulk entity failed with a retryable status is resent. */
+    std::size_t getBulkRetries() const;
+    /** @brief Retrieves the format of GET results. */
+    const std::string& getOutputFormat() const;
+    /** @brief Retrieves the file receiving GET results (empty for the console). */
+    const std::string& getOutputFile() const;
+    /** @brief Retrieves the state file of incremental runs (empty for full runs). */
+    const std::string& getSinceState() const;
+    /** @brief Retrieves the seconds an EMS response is used without a request (0 if the cache is off). */
+    std::size_t getCacheTtl() const;
+    /** @brief Retrieves the number of EMS responses cached in memory. */
+    std::size_t getCacheEntries() const;
+    /** @brief Retrieves the file keeping tokens between runs (empty if there is none). */
+    const std::string& getTokenCache() const;
+    /** @brief Retrieves the number of threads writing JSON action files. */
+    std::size_t getJsonWriteThreads() const;
+    /** @brief Retrieves the maximum number of JSON action files queued or being written. */
+    std::size_t getJsonMaxOutstanding() const;
+    /** @brief Checks whether JSON action files are written without indentation. */
+    bool isJsonCompact() const;
+    /** @brief Checks whether JSON action files are synced to disk. */
+    bool isJsonDurable() const;
+    /** @brief Retrieves the folder layout of per-record output. */
+    const std::string& getOutputLayout() const;
+    /** @brief Retrieves the tar archive receiving JSON action files and attachments. */
+    const std::string& getOutputArchive() const;
 
     /**
      * @brief Converts an Action enum to its string representation.
@@ -176,6 +259,30 @@ private:
     std::string att_action_output_;
     std::string att_action_field_;
     std::string att_action_output_folder_;
+    std::size_t io_threads_;
+    std::size_t request_timeout_;
+    std::size_t att_parallelism_;
+    bool att_refresh_;
+    bool att_dedup_;
+    std::size_t page_size_;
+    std::size_t page_concurrency_;
+    std::size_t bulk_batch_size_;
+    std::size_t bulk_concurrency_;
+    std::size_t csv_threads_;
+    bool resume_;
+    std::size_t bulk_retries_;
+    std::string output_format_;
+    std::string output_file_;
+    std::string since_state_;
+    std::size_t cache_ttl_;
+    std::size_t cache_entries_;
+    std::string token_cache_;
+    std::size_t json_write_threads_;
+    std::size_t json_max_outstanding_;
+    bool json_compact_;
+    bool json_durable_;
+    std::string output_layout_;
+    std::string output_archive_;
 };
 
 } // namespace smax_ns
@@ -1,24 +1,29 @@
 #include "ConsoleSpinner.h"
 
 std::mutex ConsoleSpinner::cout_mutex_;
+std::ostream* ConsoleSpinner::out_ = &std::cout;
+std::atomic<bool> ConsoleSpinner::enabled_{true};
 
 ConsoleSpinner::ConsoleSpinner(const std::string& operation)
     : stop_flag_(false), operation_(operation) {
+    if (!enabled_) return;
+
     {
         std::lock_guard<std::mutex> lock(cout_mutex_);
-        std::cout << operation_ << "..." << std::flush;
+        *out_ << operation_ << "..." << std::flush;
     }
     spinner_thread_ = std::thread(&ConsoleSpinner::run, this);
 }
 
 ConsoleSpinner::~ConsoleSpinner() {
+    // A disabled spinner has no thread and prints nothing
+    if (!spinner_thread_.joinable()) return;
+
     stop_flag_ = true;
-    if (spinner_thread_.joinable()) {
-        spinner_thread_.join();
-    }
+    spinner_thread_.join();
     {
         std::lock_guard<std::mutex> lock(cout_mutex_);
-        std::cout << " " << status_ << std::endl;
+        *out_ << " " << status_ << std::endl;
     }
 }
 
@@ -26,11 +31,20 @@ void ConsoleSpinner::setStatus(const std::string& status) {
     status_ = status;
 }
 
+void ConsoleSpinner::setOutput(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(cout_mutex_);
+    out_ = &out;
+}
+
+void ConsoleSpinner::setEnabled(bool enabled) {
+    enabled_ = enabled;
+}
+
 void ConsoleSpinner::run() {
     while (!stop_flag_) {
         {
             std::lock_guard<std::mutex> lock(cout_mutex_);
-            std::cout << "." << std::flush;
+            *out_ << "." << std::flush;
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
     }
@@ -32,12 +32,26 @@ public:
      */
     void setStatus(const std::string& status);
 
+    /**
+     * @brief Selects the stream spinners write to (std::cout by default).
+     * @param out The stream, e.g. std::cerr when std::cout carries the results.
+     */
+    static void setOutput(std::ostream& out);
+
+    /**
+     * @brief Turns all spinners on or off, e.g. off while several jobs run at once.
+     * @param enabled false makes spinners print nothing.
+     */
+    static void setEnabled(bool enabled);
+
 private:
     std::atomic<bool> stop_flag_; ///< Flag to indicate when the spinner should stop.
     std::thread spinner_thread_;  ///< Thread running the spinner animation.
     std::string operation_;       ///< Name of the operation being performed.
     std::string status_;          ///< Final status message displayed when the spinner stops.
     static std::mutex cout_mutex_; ///< Mutex to ensure thread-safe console output.
+    static std::ostream* out_;     ///< Stream the spinners write to.
+    static std::atomic<bool> enabled_; ///< Spinners print nothing when false.
 
     /**
      * @brief Runs the spinner animation until stopped.
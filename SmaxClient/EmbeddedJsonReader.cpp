@@ -0,0 +1,224 @@
+#include "EmbeddedJsonReader.h"
+
+namespace smax_ns {
+
+bool EmbeddedJsonReader::parse(std::string_view text, json& out) {
+#ifdef SMAX_WITH_SIMDJSON
+    return parseSimd(text, out);
+#else
+    return parseDom(text, out);
+#endif
+}
+
+bool EmbeddedJsonReader::readAttachments(const std::string& record_id, std::string_view text,
+                                         std::vector<Attachment>& attachments, std::string& error) {
+#ifdef SMAX_WITH_SIMDJSON
+    return readAttachmentsSimd(record_id, text, attachments, error);
+#else
+    return readAttachmentsDom(record_id, text, attachments, error);
+#endif
+}
+
+bool EmbeddedJsonReader::parseDom(std::string_view text, json& out) {
+    try {
+        out = json::parse(text);
+        return true;
+    } catch (const json::exception&) {
+        return false;
+    }
+}
+
+bool EmbeddedJsonReader::readAttachmentsDom(const std::string& record_id, std::string_view text,
+                                            std::vector<Attachment>& attachments, std::string& error) {
+    try {
+        auto attachmentsJson = json::parse(text);
+
+        for (const auto& item : attachmentsJson["complexTypeProperties"]) {
+            const json& properties = item.at("properties");
+
+            Attachment att;
+            att.record_id = record_id;
+            att.id = properties.at("id").get<std::string>();
+            att.file_name = properties.value("file_name", "");
+            att.file_extension = properties.value("file_extension", "");
+            att.is_hidden = properties.at("IsHidden").get<bool>();
+            att.size = properties.value("size", std::uint64_t{0});
+            att.last_update_time = properties.value("LastUpdateTime", std::int64_t{0});
+
+            attachments.push_back(att);
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+
+    return true;
+}
+
+#ifdef SMAX_WITH_SIMDJSON
+
+namespace ondemand = simdjson::ondemand;
+
+simdjson::error_code EmbeddedJsonReader::iterate(std::string_view text, ondemand::document& doc) {
+    // simdjson reads up to SIMDJSON_PADDING bytes past the end of the text
+    buffer_.assign(text.data(), text.size());
+    buffer_.resize(text.size() + simdjson::SIMDJSON_PADDING);
+
+    return parser_.iterate(buffer_.data(), text.size(), buffer_.size()).get(doc);
+}
+
+bool EmbeddedJsonReader::parseSimd(std::string_view text, json& out) {
+    ondemand::document doc;
+    ondemand::value root;
+
+    if (iterate(text, doc) || doc.get_value().get(root)) return false;
+
+    json result;
+    if (toJson(root, result) || !doc.at_end()) return false;
+
+    out = std::move(result);
+    return true;
+}
+
+simdjson::error_code EmbeddedJsonReader::toJson(ondemand::value value, json& out) {
+    ondemand::json_type type;
+    if (auto error = value.type().get(type)) return error;
+
+    switch (type) {
+    case ondemand::json_type::object: {
+        ondemand::object object;
+        if (auto error = value.get_object().get(object)) return error;
+
+        out = json::object();
+        for (auto member : object) {
+            std::string_view key;
+            if (auto error = member.unescaped_key().get(key)) return error;
+
+            ondemand::value member_value;
+            if (auto error = member.value().get(member_value)) return error;
+
+            // Like nlohmann's parser, the last of duplicate keys wins
+            if (auto error = toJson(member_value, out[std::string(key)])) return error;
+        }
+        return simdjson::SUCCESS;
+    }
+    case ondemand::json_type::array: {
+        ondemand::array array;
+        if (auto error = value.get_array().get(array)) return error;
+
+        out = json::array();
+        for (auto element : array) {
+            ondemand::value element_value;
+            if (auto error = element.get(element_value)) return error;
+
+            out.push_back(nullptr);
+            if (auto error = toJson(element_value, out.back())) return error;
+        }
+        return simdjson::SUCCESS;
+    }
+    case ondemand::json_type::number: {
+        ondemand::number_type number_type;
+        if (auto error = value.get_number_type().get(number_type)) return error;
+
+        // nlohmann stores integers without a sign as unsigned and integers too large for 64 bits as double
+        if (number_type == ondemand::number_type::signed_integer) {
+            int64_t number;
+            if (auto error = value.get_int64().get(number)) return error;
+            out = number >= 0 ? json(static_cast<json::number_unsigned_t>(number)) : json(number);
+        } else if (number_type == ondemand::number_type::unsigned_integer) {
+            uint64_t number;
+            if (auto error = value.get_uint64().get(number)) return error;
+            out = number;
+        } else {
+            double number;
+            if (auto error = value.get_double().get(number)) return error;
+            out = number;
+        }
+        return simdjson::SUCCESS;
+    }
+    case ondemand::json_type::string: {
+        std::string_view text;
+        if (auto error = value.get_string().get(text)) return error;
+        out = std::string(text);
+        return simdjson::SUCCESS;
+    }
+    case ondemand::json_type::boolean: {
+        bool flag;
+        if (auto error = value.get_bool().get(flag)) return error;
+        out = flag;
+        return simdjson::SUCCESS;
+    }
+    case ondemand::json_type::null:
+        if (!value.is_null()) return simdjson::INCORRECT_TYPE;
+        out = nullptr;
+        return simdjson::SUCCESS;
+    default:
+        return simdjson::TAPE_ERROR;
+    }
+}
+
+bool EmbeddedJsonReader::readAttachmentsSimd(const std::string& record_id, std::string_view text,
+                                             std::vector<Attachment>& attachments, std::string& error) {
+    auto fail = [&error](simdjson::error_code code) {
+        error = simdjson::error_message(code);
+        return false;
+    };
+
+    ondemand::document doc;
+    ondemand::object root;
+
+    if (auto code = iterate(text, doc)) return fail(code);
+    if (auto code = doc.get_object().get(root)) return fail(code);
+
+    ondemand::value list;
+    auto code = root.find_field_unordered("complexTypeProperties").get(list);
+
+    if (code == simdjson::NO_SUCH_FIELD) return true;
+    if (code) return fail(code);
+    if (list.is_null()) return true;
+
+    ondemand::array items;
+    if (auto code = list.get_array().get(items)) return fail(code);
+
+    // An optional string property; missing is the same as empty
+    auto optional_string = [](ondemand::object& properties, const char* name, std::string& out) {
+        std::string_view value;
+        auto code = properties.find_field_unordered(name).get_string().get(value);
+        if (code == simdjson::NO_SUCH_FIELD) return simdjson::SUCCESS;
+        if (!code) out = std::string(value);
+        return code;
+    };
+
+    // An optional number property; missing is the same as 0
+    auto optional_number = [](ondemand::object& properties, const char* name, auto& out) {
+        auto field = properties.find_field_unordered(name);
+        if (field.error() == simdjson::NO_SUCH_FIELD) return simdjson::SUCCESS;
+        return field.get(out);
+    };
+
+    for (auto item : items) {
+        ondemand::object properties;
+        if (auto code = item.find_field_unordered("properties").get_object().get(properties)) return fail(code);
+
+        Attachment att;
+        att.record_id = record_id;
+
+        std::string_view id;
+        if (auto code = properties.find_field_unordered("id").get_string().get(id)) return fail(code);
+        att.id = std::string(id);
+
+        if (auto code = optional_string(properties, "file_name", att.file_name)) return fail(code);
+        if (auto code = optional_string(properties, "file_extension", att.file_extension)) return fail(code);
+        if (auto code = properties.find_field_unordered("IsHidden").get_bool().get(att.is_hidden)) return fail(code);
+        if (auto code = optional_number(properties, "size", att.size)) return fail(code);
+        if (auto code = optional_number(properties, "LastUpdateTime", att.last_update_time)) return fail(code);
+
+        attachments.push_back(att);
+    }
+
+    return true;
+}
+
+#endif
+
+} // namespace smax_ns
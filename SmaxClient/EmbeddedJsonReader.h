@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef SMAX_WITH_SIMDJSON
+#include <simdjson.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+/**
+ * @struct Attachment
+ * @brief Represents an attachment with metadata.
+ */
+struct Attachment {
+    std::string record_id;
+    std::string id;
+    std::string file_name;
+    std::string file_extension;
+    bool is_hidden;
+    std::uint64_t size = 0;             ///< File size in bytes (0 if not reported)
+    std::int64_t last_update_time = 0;  ///< LastUpdateTime in ms since the epoch (0 if not reported)
+};
+
+/**
+ * @class EmbeddedJsonReader
+ * @brief Reads the JSON documents that EMS embeds as strings in entity fields
+ * (complexTypeProperties of attachment fields, TaskPlan fields, ...).
+ *
+ * The backend is chosen at build time: nlohmann::json by default, simdjson On-Demand with
+ * the CMake option WITH_SIMDJSON. Both give the same results; the nlohmann functions stay
+ * available as the reference implementation.
+ *
+ * A reader keeps parser buffers between calls and must not be shared between threads.
+ */
+class EmbeddedJsonReader {
+public:
+    /**
+     * @brief Parses an embedded document.
+     * @param text The field value.
+     * @param out Receives the document.
+     * @return false if the text is not valid JSON.
+     */
+    bool parse(std::string_view text, json& out);
+
+    /**
+     * @brief Reads the attachments listed in an attachment field.
+     * @param record_id Id of the entity owning the field.
+     * @param text The field value ({"complexTypeProperties": [{"properties": {...}}, ...]}).
+     * @param attachments Receives the attachments in field order.
+     * @param error Receives the error if the field cannot be read; attachments read before it are kept.
+     * @return false on error.
+     */
+    bool readAttachments(const std::string& record_id, std::string_view text,
+                         std::vector<Attachment>& attachments, std::string& error);
+
+    /**
+     * @brief Reference implementation of parse() on nlohmann::json.
+     */
+    static bool parseDom(std::string_view text, json& out);
+
+    /**
+     * @brief Reference implementation of readAttachments() on nlohmann::json.
+     */
+    static bool readAttachmentsDom(const std::string& record_id, std::string_view text,
+                                   std::vector<Attachment>& attachments, std::string& error);
+
+#ifdef SMAX_WITH_SIMDJSON
+    /**
+     * @brief simdjson implementation of parse().
+     */
+    bool parseSimd(std::string_view text, json& out);
+
+    /**
+     * @brief simdjson implementation of readAttachments().
+     */
+    bool readAttachmentsSimd(const std::string& record_id, std::string_view text,
+                             std::vector<Attachment>& attachments, std::string& error);
+
+private:
+    simdjson::ondemand::parser parser_;     ///< Reused between documents
+    std::string buffer_;                    ///< Copy of the text followed by the padding simdjson needs
+
+    /**
+     * @brief Copies the text into buffer_ and starts iterating it.
+     */
+    simdjson::error_code iterate(std::string_view text, simdjson::ondemand::document& doc);
+
+    /**
+     * @brief Converts a value into the nlohmann::json nlohmann's own parser would produce.
+     */
+    static simdjson::error_code toJson(simdjson::ondemand::value value, json& out);
+#endif
+};
+
+} // namespace smax_ns
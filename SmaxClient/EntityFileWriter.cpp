@@ -0,0 +1,109 @@
+#include "EntityFileWriter.h"
+
+#include <boost/asio/post.hpp>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+namespace smax_ns {
+
+EntityFileWriter::EntityFileWriter(const EntityFileWriterOptions& options)
+    : options_(options),
+      pool_(std::max<std::size_t>(options.threads, 1)),
+      limiter_(options.max_outstanding) {}
+
+EntityFileWriter::~EntityFileWriter() {
+    limiter_.wait();
+    pool_.join();
+}
+
+void EntityFileWriter::write(std::string id, fs::path file_path, json entity) {
+    limiter_.acquire();
+
+    boost::asio::post(pool_, [this, id = std::move(id), file_path = std::move(file_path), entity = std::move(entity)]() {
+        writeFile(id, file_path, entity);
+        limiter_.release();
+    });
+}
+
+bool EntityFileWriter::finish() {
+    limiter_.wait();
+
+    std::vector<fs::path> batch;
+    {
+        std::lock_guard<std::mutex> lock(sync_mutex_);
+        batch.swap(unsynced_);
+    }
+
+    if (!batch.empty() && !syncFiles(batch)) ++failed_count_;
+
+    return failed_count_ == 0;
+}
+
+std::size_t EntityFileWriter::getWrittenCount() const { return written_count_; }
+
+std::size_t EntityFileWriter::getFailedCount() const { return failed_count_; }
+
+void EntityFileWriter::writeFile(const std::string& id, const fs::path& file_path, const json& entity) {
+    const std::string text = options_.compact ? entity.dump() : entity.dump(4);
+
+    // Serialization stays parallel; only appending to the archive is serialized
+    if (options_.archive) {
+        if (options_.archive->addMember(id, file_path.generic_string(), text)) ++written_count_;
+        else ++failed_count_;
+        return;
+    }
+
+    std::ofstream out_file(file_path, std::ios::binary | std::ios::trunc);
+    if (out_file) out_file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    out_file.close();
+
+    if (!out_file) {
+        std::cerr << "Error: Could not write file " << file_path << std::endl;
+        ++failed_count_;
+        return;
+    }
+
+    ++written_count_;
+
+    if (!options_.durable) return;
+
+    std::vector<fs::path> batch;
+    {
+        std::lock_guard<std::mutex> lock(sync_mutex_);
+        unsynced_.push_back(file_path);
+        if (unsynced_.size() >= SYNC_BATCH) batch.swap(unsynced_);
+    }
+
+    if (!batch.empty() && !syncFiles(batch)) ++failed_count_;
+}
+
+bool EntityFileWriter::syncFiles(const std::vector<fs::path>& files) {
+    bool success = true;
+    std::set<fs::path> directories;
+
+    for (const auto& file : files) {
+        success = syncPath(file) && success;
+        directories.insert(file.parent_path());
+    }
+
+    // The directory entries of new files are only durable once their directory is synced
+    for (const auto& directory : directories) {
+        success = syncPath(directory) && success;
+    }
+
+    return success;
+}
+
+bool EntityFileWriter::syncPath(const fs::path& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    bool success = fd >= 0 && ::fsync(fd) == 0;
+
+    if (fd >= 0) ::close(fd);
+    if (!success) std::cerr << "Error: Could not sync " << path << std::endl;
+
+    return success;
+}
+
+} // namespace smax_ns
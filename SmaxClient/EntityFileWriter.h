@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/thread_pool.hpp>
+#include <filesystem>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../RestClient/InFlightLimiter.h"
+#include "ArchiveWriter.h"
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+/**
+ * @brief Settings of an EntityFileWriter.
+ */
+struct EntityFileWriterOptions {
+    std::size_t threads = 4;            ///< Number of threads serializing and writing files
+    std::size_t max_outstanding = 64;   ///< Maximum number of entities queued or being written
+    bool compact = false;               ///< Write json::dump() instead of json::dump(4)
+    bool durable = false;               ///< fsync the files and their directories
+    ArchiveWriter* archive = nullptr;   ///< Receives the files as members instead of the file system
+};
+
+/**
+ * @class EntityFileWriter
+ * @brief Writes entities to one file each on a pool of threads.
+ *
+ * write() hands the entity to the pool and returns at once unless max_outstanding entities
+ * are already pending, which bounds the memory used when the files are written slower than
+ * the entities arrive.
+ *
+ * In durable mode the written files are synced in batches of SYNC_BATCH by the thread that
+ * completes a batch, followed by their directories; finish() syncs the last batch.
+ */
+class EntityFileWriter {
+public:
+    /**
+     * @brief Constructs an EntityFileWriter.
+     * @param options The settings.
+     */
+    explicit EntityFileWriter(const EntityFileWriterOptions& options);
+
+    /**
+     * @brief Waits for the pending files.
+     */
+    ~EntityFileWriter();
+
+    EntityFileWriter(const EntityFileWriter&) = delete;
+    EntityFileWriter& operator=(const EntityFileWriter&) = delete;
+
+    /**
+     * @brief Queues an entity, blocking while max_outstanding entities are pending.
+     * @param id Id of the entity.
+     * @param file_path Destination file, replaced if it exists; the member name with an archive.
+     * @param entity The entity.
+     */
+    void write(std::string id, fs::path file_path, json entity);
+
+    /**
+     * @brief Waits until all queued files are written (and synced in durable mode).
+     * @return false if any file could not be written.
+     */
+    bool finish();
+
+    /** @brief Retrieves the number of files written so far. */
+    std::size_t getWrittenCount() const;
+
+    /** @brief Retrieves the number of files that could not be written. */
+    std::size_t getFailedCount() const;
+
+    /**
+     * @brief Opens a file or directory and flushes it to the storage device.
+     * @return false on error.
+     */
+    static bool syncPath(const fs::path& path);
+
+private:
+    static constexpr std::size_t SYNC_BATCH = 256;  ///< Number of files synced together in durable mode
+
+    EntityFileWriterOptions options_;
+    boost::asio::thread_pool pool_;
+    InFlightLimiter limiter_;                   ///< Bounds the pending entities
+    std::atomic<std::size_t> written_count_{0};
+    std::atomic<std::size_t> failed_count_{0};
+    std::mutex sync_mutex_;                     ///< Protects unsynced_
+    std::vector<fs::path> unsynced_;            ///< Written files not synced yet (durable mode)
+
+    /**
+     * @brief Serializes and writes one file on a pool thread.
+     */
+    void writeFile(const std::string& id, const fs::path& file_path, const json& entity);
+
+    /**
+     * @brief Syncs files, then the directories containing them.
+     * @return false if a file or directory could not be synced.
+     */
+    static bool syncFiles(const std::vector<fs::path>& files);
+};
+
+} // namespace smax_ns
@@ -0,0 +1,242 @@
+#include "EntityStream.h"
+
+#include <vector>
+
+namespace smax_ns {
+
+namespace {
+
+/**
+ * @brief SAX handler building one entity at a time.
+ *
+ * Containers being built are kept on a stack of pointers; a pointer stays valid because a
+ * container is only modified through its innermost open descendant.
+ */
+class EntitySaxHandler : public nlohmann::json_sax<json> {
+public:
+    EntitySaxHandler(const EntityConsumer& consumer, json& rest, bool& has_entities, std::size_t& entity_count)
+        : consumer_(consumer), rest_(rest), has_entities_(has_entities), entity_count_(entity_count) {}
+
+    bool null() override { return scalar(nullptr); }
+    bool boolean(bool value) override { return scalar(value); }
+    bool number_integer(number_integer_t value) override { return scalar(value); }
+    bool number_unsigned(number_unsigned_t value) override { return scalar(value); }
+    bool number_float(number_float_t value, const string_t&) override { return scalar(value); }
+    bool string(string_t& value) override { return scalar(std::move(value)); }
+    bool binary(binary_t& value) override { return scalar(json::binary(std::move(value))); }
+
+    bool start_object(std::size_t) override {
+        if (depth_ == 0) {
+            ++depth_;
+            return true;
+        }
+        return open(json::object());
+    }
+
+    bool start_array(std::size_t) override {
+        if (depth_ == 0) {
+            error_ = "EMS response is not a JSON object";
+            return false;
+        }
+
+        if (depth_ == 1 && stack_.empty() && top_key_ == "entities") {
+            in_entities_ = true;
+            has_entities_ = true;
+            ++depth_;
+            return true;
+        }
+
+        return open(json::array());
+    }
+
+    bool key(string_t& key) override {
+        if (depth_ == 1) {
+            top_key_ = std::move(key);
+        } else {
+            next_ = &(*stack_.back())[key];
+        }
+        return true;
+    }
+
+    bool end_object() override { return close(); }
+    bool end_array() override { return close(); }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+        error_ = std::string(e.what()) + " (at byte " + std::to_string(position) + ")";
+        return false;
+    }
+
+    const std::string& getError() const { return error_; }
+
+private:
+    const EntityConsumer& consumer_;
+    json& rest_;
+    bool& has_entities_;
+    std::size_t& entity_count_;
+    std::size_t depth_ = 0;             ///< Number of open containers, the response object included
+    std::vector<json*> stack_;          ///< Containers being built
+    json* next_ = nullptr;              ///< Member receiving the next value of an object
+    std::string top_key_;               ///< Last key of the response object
+    bool in_entities_ = false;          ///< Inside the "entities" array
+    json entity_;                       ///< Entity being built
+    std::string error_;
+
+    json* place(json&& value) {
+        if (stack_.empty()) {
+            if (in_entities_) {
+                entity_ = std::move(value);
+                return &entity_;
+            }
+
+            json& member = rest_[top_key_];
+            member = std::move(value);
+            return &member;
+        }
+
+        json* parent = stack_.back();
+        if (parent->is_array()) {
+            parent->push_back(std::move(value));
+            return &parent->back();
+        }
+
+        *next_ = std::move(value);
+        return next_;
+    }
+
+    bool scalar(json&& value) {
+        if (depth_ == 0) {
+            error_ = "EMS response is not a JSON object";
+            return false;
+        }
+
+        bool whole_entity = in_entities_ && stack_.empty();
+        place(std::move(value));
+        if (whole_entity) emit();
+        return true;
+    }
+
+    bool open(json&& container) {
+        stack_.push_back(place(std::move(container)));
+        ++depth_;
+        return true;
+    }
+
+    bool close() {
+        --depth_;
+
+        if (stack_.empty()) {
+            // The "entities" array or the response object itself
+            if (depth_ == 1) in_entities_ = false;
+            return true;
+        }
+
+        stack_.pop_back();
+        if (in_entities_ && stack_.empty()) emit();
+        return true;
+    }
+
+    void emit() {
+        ++entity_count_;
+        consumer_(entity_);
+        entity_ = json();
+    }
+};
+
+} // namespace
+
+EntityStreamParser::EntityStreamParser(EntityConsumer consumer) : consumer_(std::move(consumer)) {}
+
+bool EntityStreamParser::parse(std::string_view body) {
+    // Only the first response provides the other members; those of later pages are dropped
+    json scratch = json::object();
+    json& rest = response_count_++ == 0 ? rest_ : scratch;
+
+    EntitySaxHandler handler(consumer_, rest, has_entities_, entity_count_);
+
+    if (!json::sax_parse(body.begin(), body.end(), &handler)) {
+        error_ = handler.getError();
+        return false;
+    }
+
+    return true;
+}
+
+const json& EntityStreamParser::getRest() const { return rest_; }
+
+bool EntityStreamParser::hasEntities() const { return has_entities_; }
+
+std::size_t EntityStreamParser::getEntityCount() const { return entity_count_; }
+
+const std::string& EntityStreamParser::getError() const { return error_; }
+
+std::unique_ptr<EntityWriter> EntityWriter::create(const std::string& format, std::ostream& out, bool flush_each) {
+    if (format == "pretty") return std::make_unique<PrettyDocumentWriter>(out);
+    if (format == "json") return std::make_unique<CompactDocumentWriter>(out);
+    if (format == "ndjson") return std::make_unique<NdjsonWriter>(out, flush_each);
+    return nullptr;
+}
+
+PrettyDocumentWriter::PrettyDocumentWriter(std::ostream& out) : out_(out) {}
+
+void PrettyDocumentWriter::addEntity(const json& entity) {
+    out_ << (entity_count_++ == 0 ? "{\n    \"entities\": [\n        " : ",\n        ");
+    writeIndented(entity, 8);
+}
+
+void PrettyDocumentWriter::finish(const json& rest) {
+    out_ << (entity_count_ == 0 ? "{\n    \"entities\": []" : "\n    ]");
+
+    for (const auto& member : rest.items()) {
+        if (member.key() == "entities") continue;
+
+        out_ << ",\n    " << json(member.key()).dump() << ": ";
+        writeIndented(member.value(), 4);
+    }
+
+    out_ << "\n}";
+}
+
+void PrettyDocumentWriter::writeIndented(const json& value, std::size_t indent) {
+    // Line breaks inside strings are escaped, so every raw line break starts a new line of the layout
+    const std::string text = value.dump(4);
+    const std::string padding(indent, ' ');
+
+    std::size_t start = 0;
+    for (std::size_t pos = text.find('\n'); pos != std::string::npos; pos = text.find('\n', start)) {
+        out_.write(text.data() + start, pos + 1 - start);
+        out_ << padding;
+        start = pos + 1;
+    }
+    out_.write(text.data() + start, text.size() - start);
+}
+
+CompactDocumentWriter::CompactDocumentWriter(std::ostream& out) : out_(out) {}
+
+void CompactDocumentWriter::addEntity(const json& entity) {
+    out_ << (entity_count_++ == 0 ? "{\"entities\":[" : ",") << entity;
+}
+
+void CompactDocumentWriter::finish(const json& rest) {
+    out_ << (entity_count_ == 0 ? "{\"entities\":[]" : "]");
+
+    for (const auto& member : rest.items()) {
+        if (member.key() == "entities") continue;
+        out_ << ',' << json(member.key()) << ':' << member.value();
+    }
+
+    out_ << '}';
+}
+
+NdjsonWriter::NdjsonWriter(std::ostream& out, bool flush_each) : out_(out), flush_each_(flush_each) {}
+
+void NdjsonWriter::addEntity(const json& entity) {
+    // Line breaks inside strings are escaped, so the compact text is a single line
+    out_ << entity << '\n';
+    if (flush_each_) out_.flush();
+}
+
+void NdjsonWriter::finish(const json&) {
+    out_.flush();
+}
+
+} // namespace smax_ns
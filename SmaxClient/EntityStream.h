@@ -0,0 +1,181 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+/**
+ * @brief Receives one element of the "entities" array of an EMS response.
+ *
+ * The entity may be modified or moved from; it is discarded after the call.
+ */
+using EntityConsumer = std::function<void(json& entity)>;
+
+/**
+ * @class EntityStreamParser
+ * @brief Event-driven (SAX) parser of EMS responses.
+ *
+ * Each element of the top-level "entities" array is built on its own and handed to the
+ * consumer as soon as it is complete, so memory is bounded by the largest entity rather
+ * than by the response. All other top-level members (e.g. "meta") are kept.
+ *
+ * One parser can be fed several pages of the same query; the entities of all pages go to
+ * the same consumer and the other members are taken from the first page.
+ */
+class EntityStreamParser {
+public:
+    /**
+     * @brief Constructs an EntityStreamParser.
+     * @param consumer Receives the entities in response order.
+     */
+    explicit EntityStreamParser(EntityConsumer consumer);
+
+    /**
+     * @brief Parses one response.
+     * @param body The response body.
+     * @return false if the body is not a JSON object (see getError()).
+     */
+    bool parse(std::string_view body);
+
+    /** @brief Retrieves the top-level members other than "entities" of the first response. */
+    const json& getRest() const;
+
+    /** @brief Checks whether the responses contained an "entities" array. */
+    bool hasEntities() const;
+
+    /** @brief Retrieves the number of entities handed to the consumer. */
+    std::size_t getEntityCount() const;
+
+    /** @brief Retrieves the error of the last failed parse(). */
+    const std::string& getError() const;
+
+private:
+    EntityConsumer consumer_;
+    json rest_ = json::object();    ///< Top-level members other than "entities"
+    bool has_entities_ = false;
+    std::size_t entity_count_ = 0;
+    std::size_t response_count_ = 0;
+    std::string error_;
+};
+
+/**
+ * @class EntityWriter
+ * @brief Writes the entities of EMS responses as they are parsed.
+ */
+class EntityWriter {
+public:
+    virtual ~EntityWriter() = default;
+
+    /**
+     * @brief Writes the next entity.
+     * @param entity The entity.
+     */
+    virtual void addEntity(const json& entity) = 0;
+
+    /**
+     * @brief Completes the output once all entities are written.
+     * @param rest Top-level members other than "entities".
+     */
+    virtual void finish(const json& rest) = 0;
+
+    /**
+     * @brief Creates the writer of an output format.
+     * @param format pretty, json or ndjson.
+     * @param out Receives the text.
+     * @param flush_each Flush the stream after every ndjson line, so readers of a pipe get it immediately.
+     * @return The writer, or nullptr for an unknown format.
+     */
+    static std::unique_ptr<EntityWriter> create(const std::string& format, std::ostream& out, bool flush_each = false);
+};
+
+/**
+ * @class PrettyDocumentWriter
+ * @brief Writes {"entities": [...], ...} entity by entity in the layout of json::dump(4).
+ *
+ * The text is the same as the one of the whole document dumped at once, except that
+ * members sorting before "entities" are written after it.
+ */
+class PrettyDocumentWriter : public EntityWriter {
+public:
+    /**
+     * @brief Constructs a PrettyDocumentWriter.
+     * @param out Receives the text.
+     */
+    explicit PrettyDocumentWriter(std::ostream& out);
+
+    /**
+     * @brief Writes the next entity.
+     * @param entity The entity.
+     */
+    void addEntity(const json& entity) override;
+
+    /**
+     * @brief Closes the "entities" array and writes the remaining members.
+     * @param rest Top-level members other than "entities".
+     */
+    void finish(const json& rest) override;
+
+private:
+    std::ostream& out_;
+    std::size_t entity_count_ = 0;
+
+    /**
+     * @brief Writes a value dumped with an indent of 4, shifted to the given level.
+     * @param value The value.
+     * @param indent Number of spaces added in front of every line but the first.
+     */
+    void writeIndented(const json& value, std::size_t indent);
+};
+
+/**
+ * @class CompactDocumentWriter
+ * @brief Writes {"entities": [...], ...} entity by entity in the layout of json::dump(),
+ * with the same member order as PrettyDocumentWriter.
+ */
+class CompactDocumentWriter : public EntityWriter {
+public:
+    /**
+     * @brief Constructs a CompactDocumentWriter.
+     * @param out Receives the text.
+     */
+    explicit CompactDocumentWriter(std::ostream& out);
+
+    void addEntity(const json& entity) override;
+    void finish(const json& rest) override;
+
+private:
+    std::ostream& out_;
+    std::size_t entity_count_ = 0;
+};
+
+/**
+ * @class NdjsonWriter
+ * @brief Writes every entity as one compact line (newline-delimited JSON).
+ *
+ * Only entities are written; the other members of the responses are dropped.
+ */
+class NdjsonWriter : public EntityWriter {
+public:
+    /**
+     * @brief Constructs an NdjsonWriter.
+     * @param out Receives the lines.
+     * @param flush_each Flush the stream after every line.
+     */
+    NdjsonWriter(std::ostream& out, bool flush_each);
+
+    void addEntity(const json& entity) override;
+    void finish(const json& rest) override;
+
+private:
+    std::ostream& out_;
+    bool flush_each_;
+};
+
+} // namespace smax_ns
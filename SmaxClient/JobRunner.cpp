@@ -0,0 +1,108 @@
+#include "JobRunner.h"
+
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "ConsoleSpinner.h"
+#include "SMAXClient.h"
+
+namespace smax_ns {
+
+JobRunner::JobRunner(std::vector<JobSpec> jobs, std::size_t concurrency, std::size_t io_threads, std::size_t request_timeout,
+                     std::shared_ptr<ResponseCache> cache)
+    : jobs_(std::move(jobs)), concurrency_(std::max<std::size_t>(concurrency, 1)), io_threads_(io_threads),
+      request_timeout_(request_timeout), cache_(std::move(cache)) {}
+
+bool JobRunner::run() {
+    auto runtime = std::make_shared<AsyncRuntime>(io_threads_, std::chrono::seconds(request_timeout_));
+    auto token_manager = std::make_shared<TokenManager>();
+
+    std::vector<JobResult> results(jobs_.size());
+    std::atomic<std::size_t> next{0};
+    std::size_t workers = std::min(concurrency_, jobs_.size());
+
+    // Dots of concurrent spinners would be interleaved
+    if (workers > 1) ConsoleSpinner::setEnabled(false);
+
+    auto started = std::chrono::steady_clock::now();
+
+    auto work = [&]() {
+        for (std::size_t index = next++; index < jobs_.size(); index = next++) {
+            JobResult& result = results[index];
+            auto job_started = std::chrono::steady_clock::now();
+
+            try {
+                auto params = ConnectionParameters::create(jobs_[index].input_values);
+                auto client = SMAXClient::create(*params, runtime, token_manager, cache_);
+
+                result.message = client->doAction();
+                result.succeeded = client->isSucceeded();
+            } catch (const std::exception& e) {
+                result.message = std::string("ERROR: ") + e.what();
+            }
+
+            result.elapsed = std::chrono::steady_clock::now() - job_started;
+            report(index, result);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < workers; ++i) threads.emplace_back(work);
+    work();
+    for (auto& thread : threads) thread.join();
+
+    ConsoleSpinner::setEnabled(true);
+
+    std::cout << formatSummary(results, std::chrono::steady_clock::now() - started);
+
+    for (const auto& result : results) {
+        if (!result.succeeded) return false;
+    }
+    return true;
+}
+
+void JobRunner::report(std::size_t index, const JobResult& result) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2)
+        << "**************Job " << index + 1 << " (" << jobs_[index].name << "): "
+        << (result.succeeded ? "OK" : "FAILED") << " in "
+        << std::chrono::duration<double>(result.elapsed).count() << " s********************\n";
+
+    if (!result.message.empty()) oss << result.message << "\n";
+
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    std::cout << oss.str() << std::flush;
+}
+
+std::string JobRunner::formatSummary(const std::vector<JobResult>& results,
+                                     std::chrono::steady_clock::duration elapsed) const {
+    std::size_t failed = 0;
+    for (const auto& result : results) {
+        if (!result.succeeded) ++failed;
+    }
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2)
+        << "**************Jobs:********************\n"
+        << "Jobs: " << results.size() << ", succeeded: " << results.size() - failed << ", failed: " << failed
+        << ", " << std::chrono::duration<double>(elapsed).count() << " s\n";
+
+    if (cache_) oss << cache_->formatSummary() << "\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& values = jobs_[i].input_values;
+
+        oss << std::setw(4) << i + 1 << "  " << std::left << std::setw(7) << (results[i].succeeded ? "OK" : "FAILED")
+            << std::right << std::setw(9) << std::chrono::duration<double>(results[i].elapsed).count() << " s  "
+            << std::left << std::setw(15) << values.action << std::setw(15) << values.entity << std::right
+            << jobs_[i].name << "\n";
+    }
+
+    return oss.str();
+}
+
+} // namespace smax_ns
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ConnectionProperties.h"
+#include "ResponseCache.h"
+
+namespace smax_ns {
+
+/**
+ * @brief One job of a jobs file (--jobs).
+ */
+struct JobSpec {
+    std::size_t line = 0;       ///< Line of the jobs file
+    std::string name;           ///< "name" of the job, or "line <n>"
+    InputValues input_values;   ///< Command line options overridden by the job
+};
+
+/**
+ * @brief Outcome of a job.
+ */
+struct JobResult {
+    bool succeeded = false;     ///< All requests succeeded and all output was written
+    std::string message;        ///< Result of the action, or the error
+    std::chrono::steady_clock::duration elapsed{}; ///< Wall time of the job
+};
+
+/**
+ * @class JobRunner
+ * @brief Runs the jobs of a jobs file in one process.
+ *
+ * Every job gets its own ConnectionParameters and SMAXClient, but all of them share one
+ * AsyncRuntime (I/O threads, keep-alive connections), one token and one response cache,
+ * so the process authenticates once. Up to `concurrency` jobs run at the same time. The result of each
+ * job is printed when it ends, followed by a summary of all jobs.
+ */
+class JobRunner {
+public:
+    /**
+     * @brief Constructs a JobRunner.
+     * @param jobs The jobs, in file order.
+     * @param concurrency Maximum number of jobs running at the same time.
+     * @param io_threads Number of network I/O threads shared by all jobs.
+     * @param request_timeout Seconds the server may take to accept or send data.
+     * @param cache Response cache shared by all jobs, or nullptr.
+     */
+    JobRunner(std::vector<JobSpec> jobs, std::size_t concurrency, std::size_t io_threads, std::size_t request_timeout,
+              std::shared_ptr<ResponseCache> cache = nullptr);
+
+    /**
+     * @brief Runs all jobs and blocks until the last one is finished.
+     * @return true if every job succeeded.
+     */
+    bool run();
+
+private:
+    std::vector<JobSpec> jobs_;
+    std::size_t concurrency_;
+    std::size_t io_threads_;
+    std::size_t request_timeout_;
+    std::shared_ptr<ResponseCache> cache_;
+    std::mutex output_mutex_;   ///< Keeps the results of concurrent jobs apart
+
+    /**
+     * @brief Prints the result of a finished job.
+     */
+    void report(std::size_t index, const JobResult& result);
+
+    /**
+     * @brief Formats the summary of all jobs.
+     */
+    std::string formatSummary(const std::vector<JobResult>& results,
+                              std::chrono::steady_clock::duration elapsed) const;
+};
+
+} // namespace smax_ns
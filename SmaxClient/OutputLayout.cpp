@@ -0,0 +1,96 @@
+#include "OutputLayout.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+namespace smax_ns {
+
+OutputLayout::OutputLayout(const std::string& mode, fs::path root, bool merge) : root_(std::move(root)), merge_(merge) {
+    if (mode == "flat") mode_ = Mode::FLAT;
+    else if (mode == "prefix") mode_ = Mode::PREFIX;
+    else if (mode == "hash") mode_ = Mode::HASH;
+    else throw std::invalid_argument("Unknown output layout: " + mode);
+
+    if (!merge_ || mode_ == Mode::FLAT) return;
+
+    std::ifstream in(root_ / INDEX_FILE_NAME, std::ios::binary);
+    std::string line;
+
+    while (std::getline(in, line)) {
+        auto tab = line.find('\t');
+        if (tab != std::string::npos) indexed_.insert(line.substr(0, tab));
+    }
+}
+
+bool OutputLayout::isValidMode(const std::string& mode) {
+    return mode == "flat" || mode == "prefix" || mode == "hash";
+}
+
+fs::path OutputLayout::subfolderFor(const std::string& id) const {
+    if (mode_ == Mode::FLAT) return {};
+
+    std::string key;
+
+    if (mode_ == Mode::PREFIX) {
+        key = id.size() < 4 ? std::string(4 - id.size(), '0') + id : id.substr(0, 4);
+
+        // Keep separators and dots of unusual Ids out of the folder names
+        for (auto& c : key) {
+            if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+        }
+    } else {
+        uint32_t hash = 2166136261u;
+        for (unsigned char c : id) {
+            hash = (hash ^ c) * 16777619u;
+        }
+
+        // FNV-1a barely changes its high bits for sequential Ids; mix them (murmur3 finalizer)
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+
+        char hex[9];
+        std::snprintf(hex, sizeof(hex), "%08x", static_cast<unsigned>(hash));
+        key.assign(hex, 4);
+    }
+
+    return fs::path(key.substr(0, 2)) / key.substr(2, 2);
+}
+
+fs::path OutputLayout::place(const std::string& id, const std::string& name) {
+    fs::path subfolder = subfolderFor(id);
+
+    if (mode_ == Mode::FLAT) return root_ / name;
+
+    if (created_.insert(subfolder.string()).second) {
+        fs::create_directories(root_ / subfolder);
+    }
+
+    if (indexed_.insert(id).second) {
+        if (!index_.is_open()) {
+            index_.open(root_ / INDEX_FILE_NAME, std::ios::binary | (merge_ ? std::ios::app : std::ios::trunc));
+        }
+        index_ << id << '\t' << (subfolder / name).generic_string() << '\n';
+    }
+
+    return root_ / subfolder / name;
+}
+
+bool OutputLayout::finish() {
+    if (!index_.is_open()) return true;
+
+    index_.close();
+    if (!index_) {
+        std::cerr << "Error: Could not write " << (root_ / INDEX_FILE_NAME) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace smax_ns
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace smax_ns {
+
+/**
+ * @class OutputLayout
+ * @brief Places per-record output (JSON files, attachment folders) under a root folder.
+ *
+ * - flat: <root>/<name>
+ * - prefix: <root>/<first 2 characters of the Id>/<next 2>/<name>, e.g. 13/44/134489.json;
+ *   Ids shorter than 4 characters are padded with leading zeros
+ * - hash: <root>/<hh>/<hh>/<name> from the first two bytes of a hash of the Id (FNV-1a, mixed),
+ *   which spreads sequential Ids evenly over 65536 folders
+ *
+ * With prefix and hash, every placed Id is appended once to <root>/index.tsv as
+ * "<Id>\t<path relative to root>", so a record can be found without walking the tree.
+ * A merging layout (incremental runs) keeps the Ids of the existing index and appends to it.
+ *
+ * Not thread-safe; the placing thread must be the only user.
+ */
+class OutputLayout {
+public:
+    static constexpr const char* INDEX_FILE_NAME = "index.tsv";
+
+    /**
+     * @brief Constructs an OutputLayout.
+     * @param mode flat, prefix or hash.
+     * @param root The root folder, which must exist.
+     * @param merge Keep the existing index and append to it instead of replacing it.
+     * @throws std::invalid_argument for an unknown mode.
+     */
+    OutputLayout(const std::string& mode, fs::path root, bool merge = false);
+
+    /**
+     * @brief Checks whether a layout name is known.
+     */
+    static bool isValidMode(const std::string& mode);
+
+    /**
+     * @brief Retrieves the path of a record's output and creates its parent folders.
+     * @param id Id of the record.
+     * @param name File or folder name of the output.
+     * @return <root>/<fan-out folders>/<name>.
+     */
+    fs::path place(const std::string& id, const std::string& name);
+
+    /**
+     * @brief Retrieves the fan-out folders of an Id relative to the root (empty for flat).
+     */
+    fs::path subfolderFor(const std::string& id) const;
+
+    /**
+     * @brief Flushes the index.
+     * @return false if the index could not be written.
+     */
+    bool finish();
+
+private:
+    enum class Mode { FLAT, PREFIX, HASH };
+
+    Mode mode_;
+    fs::path root_;
+    bool merge_;
+    std::ofstream index_;                       ///< Opened by the first place() in prefix and hash modes
+    std::unordered_set<std::string> indexed_;   ///< Ids already written to the index
+    std::unordered_set<std::string> created_;   ///< Fan-out folders known to exist
+};
+
+} // namespace smax_ns
@@ -0,0 +1,528 @@
+#include "QueryServer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <poll.h>
+#include <sstream>
+#include <thread>
+
+#include "ConsoleSpinner.h"
+#include "EntityStream.h"
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+
+namespace smax_ns {
+
+namespace {
+
+/**
+ * @brief Decodes %XX escapes and '+' of a query string component.
+ */
+std::string url_decode(const std::string& value) {
+    std::string result;
+    result.reserve(value.size());
+
+    for (std::size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            result += ' ';
+        } else if (value[i] == '%' && i + 2 < value.size() &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            result += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            result += value[i];
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief Splits a request target into its path and query parameters.
+ */
+std::string parse_target(const std::string& target, std::map<std::string, std::string>& params) {
+    auto question = target.find('?');
+    if (question == std::string::npos) return target;
+
+    std::istringstream query(target.substr(question + 1));
+    std::string pair;
+
+    while (std::getline(query, pair, '&')) {
+        auto equals = pair.find('=');
+        if (equals == std::string::npos) {
+            params[url_decode(pair)] = "";
+        } else {
+            params[url_decode(pair.substr(0, equals))] = url_decode(pair.substr(equals + 1));
+        }
+    }
+
+    return target.substr(0, question);
+}
+
+/**
+ * @brief Thrown from the consumer of a query whose clients have all gone away.
+ */
+struct QueryCancelled {};
+
+} // namespace
+
+QueryServer::QueryServer(InputValues input_values, std::string address)
+    : input_values_(std::move(input_values)), address_(std::move(address)),
+      runtime_(std::make_shared<AsyncRuntime>(input_values_.io_threads, std::chrono::seconds(input_values_.request_timeout))),
+      token_manager_(std::make_shared<TokenManager>()) {
+    if (input_values_.cache_ttl > 0) {
+        cache_ = std::make_shared<ResponseCache>(fs::path(input_values_.output_folder) / ResponseCache::FOLDER,
+                                                 std::chrono::seconds(input_values_.cache_ttl),
+                                                 input_values_.cache_entries);
+    }
+
+    // Every query is a GET; its results go to the client only
+    input_values_.action = "GET";
+    input_values_.output_file.clear();
+    input_values_.since_state.clear();
+}
+
+bool QueryServer::run() {
+    auto colon = address_.rfind(':');
+    if (colon == std::string::npos) {
+        std::cerr << "ERROR: --serve expects <address>:<port>, got " << address_ << "\n";
+        return false;
+    }
+
+    beast::error_code ec;
+    std::string host = address_.substr(0, colon);
+    // [::1]:8080
+    if (host.size() > 1 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+
+    auto address = net::ip::make_address(host, ec);
+    unsigned long port = 0;
+    try {
+        port = std::stoul(address_.substr(colon + 1));
+    } catch (const std::exception&) {
+        port = 0;
+    }
+
+    if (ec || port == 0 || port > 65535) {
+        std::cerr << "ERROR: invalid address or port in --serve " << address_ << "\n";
+        return false;
+    }
+
+    // Every client gets SMAX data with the credentials of the daemon
+    if (!address.is_loopback() && !input_values_.serve_remote) {
+        std::cerr << "ERROR: --serve " << address_ << " is not a loopback address; the query API has no "
+                  << "authentication, add --serve-remote to allow it\n";
+        return false;
+    }
+
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc);
+    tcp::endpoint endpoint(address, static_cast<unsigned short>(port));
+
+    acceptor.open(endpoint.protocol(), ec);
+    if (!ec) acceptor.set_option(net::socket_base::reuse_address(true), ec);
+    if (!ec) acceptor.bind(endpoint, ec);
+    if (!ec) acceptor.listen(net::socket_base::max_listen_connections, ec);
+
+    if (ec) {
+        std::cerr << "ERROR: impossible to listen on " << address_ << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    // Dots of concurrent queries would be interleaved with the log
+    ConsoleSpinner::setEnabled(false);
+
+    net::signal_set signals(ioc, SIGINT, SIGTERM);
+    signals.async_wait([&](const beast::error_code&, int) { shutdown(acceptor); });
+
+    std::function<void()> accept = [&]() {
+        acceptor.async_accept([&](beast::error_code accept_ec, tcp::socket socket) {
+            if (accept_ec) return;
+
+            {
+                // Registered before the thread starts, so shutdown() reaches every connection
+                std::lock_guard<std::mutex> lock(threads_mutex_);
+                if (connections_ < MAX_CONNECTIONS) {
+                    ++connections_;
+                    auto connection = std::make_shared<tcp::socket>(std::move(socket));
+                    sockets_.insert(connection);
+                    std::thread(&QueryServer::serveConnection, this, std::move(connection)).detach();
+                }
+            }
+
+            if (socket.is_open()) {
+                http::response<http::string_body> busy{http::status::service_unavailable, 11};
+                busy.set(http::field::content_type, "application/json");
+                busy.body() = R"({"error": "too many connections"})";
+                busy.prepare_payload();
+                busy.keep_alive(false);
+
+                beast::error_code write_ec;
+                http::write(socket, busy, write_ec);
+            }
+
+            accept();
+        });
+    };
+
+    std::cout << "Serving SMAX queries on " << address_ << " (GET /query, GET /health)" << std::endl;
+
+    accept();
+    ioc.run();
+
+    // The connection threads and queries refer to this server
+    std::unique_lock<std::mutex> lock(threads_mutex_);
+    threads_done_.wait(lock, [this] { return connections_ == 0 && queries_ == 0; });
+
+    if (cache_) std::cout << cache_->formatSummary() << "\n";
+    std::cout << "Server stopped" << std::endl;
+    return true;
+}
+
+void QueryServer::shutdown(tcp::acceptor& acceptor) {
+    beast::error_code ec;
+    acceptor.close(ec);
+
+    // Unblocks the connection threads waiting for a request or sending a result
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    for (const auto& socket : sockets_) {
+        socket->shutdown(tcp::socket::shutdown_both, ec);
+    }
+}
+
+void QueryServer::serveConnection(std::shared_ptr<tcp::socket> socket) {
+    beast::flat_buffer buffer;
+    beast::error_code ec;
+
+    for (;;) {
+        http::request<http::string_body> request;
+        if (!readRequest(*socket, buffer, request)) break;
+
+        if (!respond(*socket, request)) break;
+    }
+
+    socket->shutdown(tcp::socket::shutdown_send, ec);
+
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    sockets_.erase(socket);
+    --connections_;
+    threads_done_.notify_all();
+}
+
+bool QueryServer::readRequest(tcp::socket& socket, beast::flat_buffer& buffer, http::request<http::string_body>& request) {
+    using Clock = std::chrono::steady_clock;
+
+    // http::read blocks without a limit, so the socket is polled with the time left
+    http::request_parser<http::string_body> parser;
+    beast::error_code ec;
+    bool started = buffer.size() > 0;
+    Clock::time_point deadline = Clock::now() + (started ? REQUEST_TIMEOUT : IDLE_TIMEOUT);
+
+    for (;;) {
+        if (buffer.size() > 0) {
+            buffer.consume(parser.put(buffer.data(), ec));
+
+            if (ec == http::error::need_more) {
+                ec = {};
+            } else if (ec) {
+                return false;
+            } else if (parser.is_done()) {
+                request = parser.release();
+                return true;
+            } else if (buffer.size() > 0) {
+                continue;
+            }
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        if (remaining.count() <= 0) return false;
+
+        pollfd fd{socket.native_handle(), POLLIN, 0};
+        int ready = ::poll(&fd, 1, static_cast<int>(remaining.count()));
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return false;
+
+        std::size_t received = socket.read_some(buffer.prepare(CHUNK_SIZE), ec);
+        if (ec) return false;
+        buffer.commit(received);
+
+        if (!started) {
+            started = true;
+            deadline = Clock::now() + REQUEST_TIMEOUT;
+        }
+    }
+}
+
+bool QueryServer::respond(tcp::socket& socket, const http::request<http::string_body>& request) {
+    beast::error_code ec;
+    bool keep_alive = request.keep_alive();
+
+    auto reply = [&](http::status status, const json& body) {
+        http::response<http::string_body> response{status, request.version()};
+        response.set(http::field::content_type, "application/json");
+        response.keep_alive(keep_alive);
+        response.body() = body.dump() + "\n";
+        response.prepare_payload();
+
+        http::write(socket, response, ec);
+        return !ec && keep_alive;
+    };
+
+    if (request.method() != http::verb::get) {
+        return reply(http::status::method_not_allowed, {{"error", "only GET is supported"}});
+    }
+
+    std::map<std::string, std::string> params;
+    std::string path = parse_target(std::string(request.target()), params);
+
+    if (path == "/health") {
+        json health{{"status", "ok"}};
+        {
+            std::lock_guard<std::mutex> lock(threads_mutex_);
+            health["connections"] = connections_;
+            health["queries"] = queries_;
+        }
+        if (cache_) health["cache"] = cache_->formatSummary();
+        return reply(http::status::ok, health);
+    }
+
+    if (path != "/query") {
+        return reply(http::status::not_found, {{"error", "unknown path " + path}});
+    }
+
+    Query query;
+    query.entity = params.count("entity") ? params["entity"] : input_values_.entity;
+    query.layout = params.count("layout") ? params["layout"] : input_values_.layout;
+    query.filter = params.count("filter") ? params["filter"] : input_values_.filter;
+    query.format = params.count("format") ? params["format"] : "ndjson";
+
+    if (query.entity.empty() || query.layout.empty()) {
+        return reply(http::status::bad_request, {{"error", "entity and layout must not be empty"}});
+    }
+
+    if (query.format != "ndjson" && query.format != "json" && query.format != "pretty") {
+        return reply(http::status::bad_request, {{"error", "acceptable formats are: ndjson, json, pretty"}});
+    }
+
+    std::shared_ptr<Flight> flight;
+    auto subscriber = join(query, flight);
+
+    bool open = stream(socket, *flight, *subscriber, query, keep_alive);
+
+    // A client that went away must not hold the chunks of the others nor keep the query running
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        subscriber->closed = true;
+        subscriber->chunks.clear();
+    }
+    flight->changed.notify_all();
+
+    return open;
+}
+
+std::shared_ptr<QueryServer::Subscriber> QueryServer::join(const Query& query, std::shared_ptr<Flight>& flight) {
+    auto subscriber = std::make_shared<Subscriber>();
+
+    std::lock_guard<std::mutex> lock(flights_mutex_);
+    auto found = flights_.find(query.key());
+
+    if (found != flights_.end()) {
+        std::lock_guard<std::mutex> flight_lock(found->second->mutex);
+        if (!found->second->published) {
+            found->second->subscribers.push_back(subscriber);
+            flight = found->second;
+            return subscriber;
+        }
+    }
+
+    flight = std::make_shared<Flight>();
+    flight->subscribers.push_back(subscriber);
+    flights_[query.key()] = flight;
+
+    {
+        std::lock_guard<std::mutex> threads_lock(threads_mutex_);
+        ++queries_;
+    }
+    std::thread(&QueryServer::fetch, this, query, flight).detach();
+
+    return subscriber;
+}
+
+void QueryServer::fetch(Query query, std::shared_ptr<Flight> flight) {
+    auto started = std::chrono::steady_clock::now();
+
+    InputValues values = input_values_;
+    values.entity = query.entity;
+    values.layout = query.layout;
+    values.filter = query.filter;
+    values.output_format = query.format;
+
+    std::ostringstream out;
+    std::size_t count = 0;
+    bool succeeded = false;
+    bool cancelled = false;
+    int status_code = 0;
+
+    // Hands the text collected so far to the clients; the first chunk closes the flight to new clients
+    auto publish = [&](bool last) {
+        if (!last && static_cast<std::size_t>(out.tellp()) < CHUNK_SIZE) return;
+
+        auto chunk = std::make_shared<const std::string>(out.str());
+        out.str("");
+        if (chunk->empty()) return;
+
+        {
+            std::unique_lock<std::mutex> lock(flight->mutex);
+
+            // A slow client holds the query back instead of the result piling up in memory
+            auto open = [&] {
+                return std::any_of(flight->subscribers.begin(), flight->subscribers.end(),
+                                   [](const auto& subscriber) { return !subscriber->closed; });
+            };
+            flight->changed.wait(lock, [&] {
+                return std::none_of(flight->subscribers.begin(), flight->subscribers.end(), [](const auto& subscriber) {
+                    return !subscriber->closed && subscriber->chunks.size() >= MAX_QUEUED_CHUNKS;
+                });
+            });
+
+            if (!open()) {
+                // Clients arriving from now on start a query of their own
+                flight->published = true;
+                throw QueryCancelled();
+            }
+
+            flight->published = true;
+            for (auto& subscriber : flight->subscribers) {
+                if (!subscriber->closed) subscriber->chunks.push_back(chunk);
+            }
+        }
+        flight->changed.notify_all();
+    };
+
+    try {
+        auto params = ConnectionParameters::create(values);
+        auto client = SMAXClient::create(*params, runtime_, token_manager_, cache_);
+        auto writer = EntityWriter::create(query.format, out);
+        json rest;
+
+        succeeded = client->queryEntities([&](json& entity) {
+            writer->addEntity(entity);
+            ++count;
+            publish(false);
+        }, rest, status_code);
+
+        if (succeeded) {
+            writer->finish(rest);
+            if (query.format != "ndjson") out << "\n";
+            publish(true);
+        }
+    } catch (const QueryCancelled&) {
+        cancelled = true;
+    } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+
+    std::size_t clients = 0;
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        flight->published = true;
+        flight->done = true;
+        flight->succeeded = succeeded;
+        flight->status_code = status_code;
+        clients = flight->subscribers.size();
+    }
+    flight->changed.notify_all();
+
+    {
+        std::lock_guard<std::mutex> lock(flights_mutex_);
+        auto found = flights_.find(query.key());
+        if (found != flights_.end() && found->second == flight) flights_.erase(found);
+    }
+
+    {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(2)
+            << "GET " << query.entity << " [" << query.layout << "]"
+            << (query.filter.empty() ? "" : " filter " + query.filter) << ": "
+            << (succeeded ? "OK" : cancelled ? "CANCELLED" : "FAILED (" + std::to_string(status_code) + ")") << ", "
+            << count << " records, " << clients << (clients == 1 ? " client, " : " clients, ")
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() << " s\n";
+
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        std::cout << oss.str() << std::flush;
+    }
+
+    std::lock_guard<std::mutex> lock(threads_mutex_);
+    --queries_;
+    threads_done_.notify_all();
+}
+
+bool QueryServer::stream(tcp::socket& socket, Flight& flight, Subscriber& subscriber, const Query& query, bool keep_alive) {
+    beast::error_code ec;
+    bool header_sent = false;
+
+    for (;;) {
+        std::deque<std::shared_ptr<const std::string>> chunks;
+        bool done = false;
+        bool succeeded = false;
+        int status_code = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(flight.mutex);
+            flight.changed.wait(lock, [&] { return !subscriber.chunks.empty() || flight.done; });
+            chunks.swap(subscriber.chunks);
+            done = flight.done;
+            succeeded = flight.succeeded;
+            status_code = flight.status_code;
+        }
+
+        // The query may wait for this client to take its chunks
+        flight.changed.notify_all();
+
+        if (!header_sent) {
+            // Nothing was sent yet, so the failure can still get a status of its own
+            if (chunks.empty() && !succeeded) {
+                http::response<http::string_body> response{http::status::bad_gateway, 11};
+                response.set(http::field::content_type, "application/json");
+                response.keep_alive(keep_alive);
+                response.body() = json{{"error", "SMAX query failed"}, {"status", status_code}}.dump() + "\n";
+                response.prepare_payload();
+
+                http::write(socket, response, ec);
+                return !ec && keep_alive;
+            }
+
+            http::response<http::empty_body> response{http::status::ok, 11};
+            response.set(http::field::content_type, query.format == "ndjson" ? "application/x-ndjson" : "application/json");
+            response.keep_alive(keep_alive);
+            response.chunked(true);
+
+            http::response_serializer<http::empty_body> serializer{response};
+            http::write_header(socket, serializer, ec);
+            if (ec) return false;
+            header_sent = true;
+        }
+
+        for (const auto& chunk : chunks) {
+            net::write(socket, http::make_chunk(net::buffer(*chunk)), ec);
+            if (ec) return false;
+        }
+
+        if (done) {
+            // A result cut off upstream ends without the last chunk, so the client sees it is incomplete
+            if (!succeeded) return false;
+
+            net::write(socket, http::make_chunk_last(), ec);
+            return !ec && keep_alive;
+        }
+    }
+}
+
+} // namespace smax_ns
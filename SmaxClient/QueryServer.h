@@ -0,0 +1,169 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../RestClient/AsyncRuntime.h"
+#include "ConnectionProperties.h"
+#include "SMAXClient.h"
+
+namespace smax_ns {
+
+/**
+ * @class QueryServer
+ * @brief Local HTTP query API of the daemon mode (--serve).
+ *
+ * The server keeps one AsyncRuntime (keep-alive connections to SMAX) and one token for its
+ * whole life, so a query costs the EMS requests only (none if --cache-ttl answers it). Endpoints:
+ *     GET /health
+ *     GET /query?entity=<entity>&layout=<fields>&filter=<EMS filter>&format=<ndjson|json|pretty>
+ * Results are streamed with chunked transfer encoding while the pages arrive. Identical
+ * queries (same entity, layout, filter and format) that arrive before the first byte of a
+ * result is sent are served by one upstream query; later ones start a new query. The query
+ * waits while MAX_QUEUED_CHUNKS chunks wait for one of its clients, and is cancelled once
+ * all of them have gone away. The API has no authentication, so only loopback addresses
+ * are accepted unless --serve-remote is given. A connection is closed when it stays idle
+ * for IDLE_TIMEOUT or does not complete a started request within REQUEST_TIMEOUT, so idle
+ * or slow clients cannot hold the MAX_CONNECTIONS slots.
+ */
+class QueryServer {
+public:
+    /// Maximum number of client connections; further connections get 503
+    static constexpr std::size_t MAX_CONNECTIONS = 64;
+
+    /// Time a connection may wait for the first byte of its next request
+    static constexpr std::chrono::seconds IDLE_TIMEOUT{30};
+
+    /// Time a request may take to arrive completely once its first byte is received
+    static constexpr std::chrono::seconds REQUEST_TIMEOUT{10};
+
+    /// Result bytes collected before they are sent as one chunk
+    static constexpr std::size_t CHUNK_SIZE = 16 * 1024;
+
+    /// Chunks waiting for one client before the upstream query waits for it
+    static constexpr std::size_t MAX_QUEUED_CHUNKS = 16;
+
+    /**
+     * @brief Constructs a QueryServer.
+     * @param input_values Options of every query (connection, paging); entity, layout and filter are defaults.
+     * @param address Listening address, "<address>:<port>".
+     */
+    QueryServer(InputValues input_values, std::string address);
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    /**
+     * @brief Serves queries until SIGINT or SIGTERM, then waits for the running queries.
+     * @return false (after printing the error) if the address cannot be used.
+     */
+    bool run();
+
+private:
+    using tcp = boost::asio::ip::tcp;
+
+    /**
+     * @brief Query of a /query request.
+     */
+    struct Query {
+        std::string entity;
+        std::string layout;
+        std::string filter;
+        std::string format;
+
+        std::string key() const { return entity + '\n' + layout + '\n' + filter + '\n' + format; }
+    };
+
+    /**
+     * @brief Chunks of a running query not yet sent to one client.
+     */
+    struct Subscriber {
+        std::deque<std::shared_ptr<const std::string>> chunks;
+        bool closed = false;    ///< The client went away
+    };
+
+    /**
+     * @brief One upstream query and the clients waiting for it.
+     */
+    struct Flight {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<std::shared_ptr<Subscriber>> subscribers;
+        bool published = false; ///< The first chunk is out; no more clients can join
+        bool done = false;
+        bool succeeded = false;
+        int status_code = 0;    ///< HTTP status code of SMAX
+    };
+
+    InputValues input_values_;
+    std::string address_;
+    std::shared_ptr<AsyncRuntime> runtime_;
+    std::shared_ptr<TokenManager> token_manager_;
+    std::shared_ptr<ResponseCache> cache_;  ///< Response cache of all queries (--cache-ttl), or nullptr
+
+    std::mutex flights_mutex_;
+    std::map<std::string, std::shared_ptr<Flight>> flights_; ///< Queries clients can still join
+
+    std::mutex threads_mutex_;
+    std::condition_variable threads_done_;
+    std::size_t connections_ = 0;   ///< Running connection threads
+    std::size_t queries_ = 0;       ///< Running upstream queries
+    std::set<std::shared_ptr<tcp::socket>> sockets_; ///< Sockets of the connection threads, closed on shutdown
+
+    std::mutex log_mutex_;
+
+    /**
+     * @brief Reads and answers the requests of one connection.
+     */
+    void serveConnection(std::shared_ptr<tcp::socket> socket);
+
+    /**
+     * @brief Reads one request within IDLE_TIMEOUT and REQUEST_TIMEOUT.
+     * @param socket The connection.
+     * @param buffer Bytes received but not parsed yet; keeps the start of a pipelined request.
+     * @param request Receives the request.
+     * @return false if the connection was closed, timed out or sent an invalid request.
+     */
+    static bool readRequest(tcp::socket& socket, boost::beast::flat_buffer& buffer,
+                            boost::beast::http::request<boost::beast::http::string_body>& request);
+
+    /**
+     * @brief Answers one request.
+     * @return false if the connection must be closed.
+     */
+    bool respond(tcp::socket& socket, const boost::beast::http::request<boost::beast::http::string_body>& request);
+
+    /**
+     * @brief Joins the running query of a client or starts a new one.
+     * @return The subscriber receiving the chunks of the result.
+     */
+    std::shared_ptr<Subscriber> join(const Query& query, std::shared_ptr<Flight>& flight);
+
+    /**
+     * @brief Runs an upstream query and hands its result to the subscribers of the flight.
+     */
+    void fetch(Query query, std::shared_ptr<Flight> flight);
+
+    /**
+     * @brief Sends the result of a flight to one client.
+     * @return false if the connection must be closed.
+     */
+    bool stream(tcp::socket& socket, Flight& flight, Subscriber& subscriber, const Query& query, bool keep_alive);
+
+    /**
+     * @brief Stops accepting and closes the client connections (SIGINT, SIGTERM).
+     */
+    void shutdown(tcp::acceptor& acceptor);
+};
+
+} // namespace smax_ns
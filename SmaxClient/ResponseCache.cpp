@@ -0,0 +1,193 @@
+#include "ResponseCache.h"
+
+#include <boost/asio/post.hpp>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <sstream>
+
+#include <openssl/evp.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+namespace {
+
+/**
+ * @brief Milliseconds since the epoch of a time point.
+ */
+std::int64_t to_millis(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+}
+
+/**
+ * @brief Name of a temporary file next to a file, unique across processes.
+ */
+fs::path temporary_path(const fs::path& path) {
+    std::ostringstream suffix;
+    suffix << "." << ::getpid() << "." << std::hex << std::random_device{}() << ".tmp";
+
+    fs::path tmp_path = path;
+    tmp_path += suffix.str();
+    return tmp_path;
+}
+
+} // namespace
+
+ResponseCache::ResponseCache(fs::path folder, std::chrono::seconds ttl, std::size_t max_entries)
+    : folder_(std::move(folder)), ttl_(ttl), max_entries_(max_entries) {}
+
+ResponseCache::~ResponseCache() {
+    writer_.join();
+}
+
+std::optional<ResponseCache::Entry> ResponseCache::find(const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = index_.find(key);
+
+        if (found != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, found->second);
+            return found->second->second;
+        }
+
+        auto pending = pending_.find(key);
+        if (pending != pending_.end()) return pending->second;
+    }
+
+    // A file holds a header line {"key", "etag", "last_modified", "stored"} followed by the body
+    std::ifstream in(pathOf(key), std::ios::binary);
+    if (!in) return std::nullopt;
+
+    std::string header_line;
+    if (!std::getline(in, header_line)) return std::nullopt;
+
+    Entry entry;
+    try {
+        json header = json::parse(header_line);
+
+        // Another key with the same digest is not a hit
+        if (header.value("key", "") != key) return std::nullopt;
+
+        entry.etag = header.value("etag", "");
+        entry.last_modified = header.value("last_modified", "");
+        entry.stored = std::chrono::system_clock::time_point(std::chrono::milliseconds(header.value("stored", std::int64_t{0})));
+    } catch (const json::exception&) {
+        return std::nullopt;
+    }
+
+    std::ostringstream body;
+    body << in.rdbuf();
+    entry.body = body.str();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    remember(key, entry);
+
+    return entry;
+}
+
+bool ResponseCache::isFresh(const Entry& entry) const {
+    return std::chrono::system_clock::now() - entry.stored < ttl_;
+}
+
+void ResponseCache::store(const std::string& key, Entry entry) {
+    entry.stored = std::chrono::system_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    remember(key, entry);
+
+    // A response stored again before it is written replaces the pending one
+    bool queued = pending_.count(key) > 0;
+    pending_[key] = std::move(entry);
+    if (queued) return;
+
+    boost::asio::post(writer_, [this, key]() {
+        bool written = write(key);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!written && !disk_failed_) {
+            disk_failed_ = true;
+            std::cerr << "Warning: responses cannot be cached in " << folder_ << std::endl;
+        }
+    });
+}
+
+bool ResponseCache::write(const std::string& key) {
+    Entry entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto pending = pending_.find(key);
+        if (pending == pending_.end()) return true;
+
+        entry = std::move(pending->second);
+        pending_.erase(pending);
+    }
+
+    fs::path path = pathOf(key);
+    // Other processes may store the same key at the same time
+    fs::path tmp_path = temporary_path(path);
+
+    std::error_code ec;
+    fs::create_directories(folder_, ec);
+    if (ec) return false;
+
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out << json{{"key", key}, {"etag", entry.etag}, {"last_modified", entry.last_modified},
+                {"stored", to_millis(entry.stored)}}.dump() << "\n" << entry.body;
+    out.close();
+
+    // Readers of the cache never see a partial file
+    bool written = out && (fs::rename(tmp_path, path, ec), !ec);
+    if (!written) fs::remove(tmp_path, ec);
+
+    return written;
+}
+
+void ResponseCache::remember(const std::string& key, const Entry& entry) {
+    if (max_entries_ == 0) return;
+
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        found->second->second = entry;
+        lru_.splice(lru_.begin(), lru_, found->second);
+        return;
+    }
+
+    lru_.emplace_front(key, entry);
+    index_[key] = lru_.begin();
+
+    if (lru_.size() > max_entries_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+fs::path ResponseCache::pathOf(const std::string& key) const {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_Digest(key.data(), key.size(), hash, &length, EVP_sha256(), nullptr);
+
+    std::ostringstream oss;
+    for (unsigned int i = 0; i < length; ++i) {
+        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    }
+
+    return folder_ / (oss.str() + ".cache");
+}
+
+void ResponseCache::countHit() { ++hits_; }
+void ResponseCache::countRevalidated() { ++revalidated_; }
+void ResponseCache::countMiss() { ++misses_; }
+
+std::string ResponseCache::formatSummary() const {
+    std::ostringstream oss;
+    oss << "Response cache: " << hits_ << (hits_ == 1 ? " hit, " : " hits, ")
+        << revalidated_ << " revalidated, " << misses_ << (misses_ == 1 ? " miss" : " misses");
+    return oss.str();
+}
+
+} // namespace smax_ns
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/thread_pool.hpp>
+#include <chrono>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace smax_ns {
+
+/**
+ * @class ResponseCache
+ * @brief Cache of EMS query responses (--cache-ttl).
+ *
+ * Responses are keyed by user and URL, which holds the tenant, entity, layout, filter and
+ * page. The most recently used ones are kept in memory; every response is also stored as
+ * "<sha256 of the key>.cache" in a folder, so later runs use it too. A response younger
+ * than the TTL is used without a request. An older one is revalidated with If-None-Match
+ * and If-Modified-Since if the server sent an ETag or Last-Modified, and requested again
+ * otherwise.
+ *
+ * The files are written by a thread of the cache, so store() does not block the I/O thread
+ * that delivers the response; a response waiting to be written is found by find() as well.
+ */
+class ResponseCache {
+public:
+    /// Folder of the disk tier under the output folder
+    static constexpr const char* FOLDER = ".cache";
+
+    /**
+     * @brief Cached response.
+     */
+    struct Entry {
+        std::string body;
+        std::string etag;           ///< ETag of the response (may be empty)
+        std::string last_modified;  ///< Last-Modified of the response (may be empty)
+        std::chrono::system_clock::time_point stored{}; ///< Time the response was received or revalidated
+    };
+
+    /**
+     * @brief Constructs a ResponseCache.
+     * @param folder Folder of the disk tier (created on first store).
+     * @param ttl Age up to which a response is used without a request.
+     * @param max_entries Number of responses kept in memory (0 keeps none).
+     */
+    ResponseCache(fs::path folder, std::chrono::seconds ttl, std::size_t max_entries);
+
+    /**
+     * @brief Waits until the pending responses are written.
+     */
+    ~ResponseCache();
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    /**
+     * @brief Looks a response up in memory, then on disk.
+     * @return The response, fresh or not, or nothing.
+     */
+    std::optional<Entry> find(const std::string& key);
+
+    /**
+     * @brief Checks whether a response can be used without a request.
+     */
+    bool isFresh(const Entry& entry) const;
+
+    /**
+     * @brief Stores a response received or revalidated now.
+     *
+     * The response is kept in memory at once and written to disk in the background.
+     */
+    void store(const std::string& key, Entry entry);
+
+    /** @brief Counts a response used without a request. */
+    void countHit();
+    /** @brief Counts a response the server confirmed unchanged (304). */
+    void countRevalidated();
+    /** @brief Counts a response requested from the server. */
+    void countMiss();
+
+    /**
+     * @brief Formats the counters, e.g. "Response cache: 3 hits, 1 revalidated, 2 misses".
+     */
+    std::string formatSummary() const;
+
+private:
+    using Lru = std::list<std::pair<std::string, Entry>>;
+
+    fs::path folder_;
+    std::chrono::seconds ttl_;
+    std::size_t max_entries_;
+
+    std::mutex mutex_;
+    Lru lru_;                   ///< Most recently used first
+    std::unordered_map<std::string, Lru::iterator> index_;
+    std::unordered_map<std::string, Entry> pending_; ///< Responses waiting to be written, the latest per key
+    bool disk_failed_ = false;  ///< A failure of the disk tier was reported
+
+    std::atomic<std::size_t> hits_{0};
+    std::atomic<std::size_t> revalidated_{0};
+    std::atomic<std::size_t> misses_{0};
+
+    boost::asio::thread_pool writer_{1}; ///< Writes the files in the order they were stored
+
+    /**
+     * @brief Keeps a response in memory, dropping the least recently used beyond max_entries.
+     * Must be called with mutex_ held.
+     */
+    void remember(const std::string& key, const Entry& entry);
+
+    /**
+     * @brief Writes the pending response of a key to its file.
+     * @return false on error.
+     */
+    bool write(const std::string& key);
+
+    /**
+     * @brief Retrieves the disk file of a key.
+     */
+    fs::path pathOf(const std::string& key) const;
+};
+
+} // namespace smax_ns
@@ -5,85 +5,41 @@ using json = nlohmann::json;
 
 namespace smax_ns {
 
-ResponseHelper& ResponseHelper::getInstance(
+std::unique_ptr<ResponseHelper> ResponseHelper::create(
     const std::string& full_path,
     const std::string& json_subfolder,
     std::shared_ptr<std::vector<std::string>> json_action_fields_list,
     std::string attachment_field
 ) {
-    static ResponseHelper instance(full_path, json_subfolder, json_action_fields_list, attachment_field);
-    return instance;
+    return std::unique_ptr<ResponseHelper>(new ResponseHelper(full_path, json_subfolder, json_action_fields_list, attachment_field));
 }
 
-bool ResponseHelper::dumpJson(const std::string& json_str, const std::string& output_method) {
-    try {
-        json parsed_json = json::parse(json_str);
-
-        return dumpJson(parsed_json, output_method);
-    } catch (const json::exception& e) {
-        std::cerr << "JSON parsing error: " << e.what() << std::endl;
-        return false;
-    }
-}
-
-bool ResponseHelper::dumpJson(json dblf, const std::string& output_method) {
+void ResponseHelper::printAttachmentsConsole(const std::vector<Attachment>& attachments) {
     std::lock_guard<std::mutex> lock(mutex_);
 
-    convertFieldsToJson(dblf);
-
-    if (!validateJson(dblf)) return false;
-
-    if (output_method == "console") {
-        printToConsole(dblf);
-    } else if (output_method == "file") {
-        return saveToFile(dblf);
-    } else {
-        std::cerr << "Error: Invalid output method." << std::endl;
-        return false;
-    }
-
-    return true;
-}
-
-void ResponseHelper::printAttachmentsConsole(const std::string& json_str) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto attachmentInfo = getAttachmentInfo(json_str);
-
-    for (const auto& att : *attachmentInfo) {
+    for (const auto& att : attachments) {
         std::cout << "Record ID:" << att.record_id << ", File ID:" << att.id
                 << ", File Name:" << att.file_name << ", Extension:" << att.file_extension
                 << ", Is Hidden:" << (att.is_hidden ? "true" : "false") << std::endl;
     }
 }
 
-std::shared_ptr<std::vector<Attachment>> ResponseHelper::getAttachmentInfo(const std::string& jsonString) {
-    auto attachments = std::make_shared<std::vector<Attachment>>();
+void ResponseHelper::getAttachmentInfo(const json& entity, std::vector<Attachment>& attachments) {
     try {
-        nlohmann::json jsonData = nlohmann::json::parse(jsonString);
-        
-        for (const auto& entity : jsonData["entities"]) {
-            std::string record_id = entity["properties"]["Id"].get<std::string>();
-            
-            if (entity["properties"].contains(attachment_field_)) {
-                auto attachmentsJson = nlohmann::json::parse(entity["properties"][attachment_field_].get<std::string>());
-                
-                for (const auto& item : attachmentsJson["complexTypeProperties"]) {
-                    Attachment att;
-                    att.record_id = record_id;
-                    att.id = item["properties"]["id"].get<std::string>();
-                    att.file_name = item["properties"].value("file_name", "");
-                    att.file_extension = item["properties"].value("file_extension", "");
-                    att.is_hidden = item["properties"]["IsHidden"].get<bool>();
-                    
-                    attachments->push_back(att);
-                }
+        const json& properties = entity.at("properties");
+        std::string record_id = properties.at("Id").get<std::string>();
+
+        if (properties.contains(attachment_field_)) {
+            std::string error;
+
+            if (!json_reader_.readAttachments(record_id, properties[attachment_field_].get_ref<const std::string&>(),
+                                              attachments, error)) {
+                std::cerr << "Error parsing JSON: " << error << std::endl;
             }
         }
     } catch (const std::exception& e) {
         std::cerr << "Error parsing JSON: " << e.what() << std::endl;
     }
-    
-    return attachments;
 }
 
 fs::path ResponseHelper::prepareDirectory(const std::string& subfolder_name) {
@@ -107,65 +63,74 @@ ResponseHelper::ResponseHelper(
     std::string attachment_field
 ) : base_path_(fs::absolute(base_path)), json_subfolder_(json_subfolder), json_action_fields_list_(json_action_fields_list), attachment_field_(attachment_field) { }
 
-void ResponseHelper::convertFieldsToJson(json& dblf) {
-    if (!dblf.contains("entities") || !dblf["entities"].is_array()) return;
+void ResponseHelper::convertFieldsToJson(json& entity) {
+    if (!entity.contains("properties") || !entity["properties"].is_object()) return;
 
-    for (auto& entity : dblf["entities"]) {
-        if (!entity.contains("properties") || !entity["properties"].is_object()) continue;
+    for (const auto& field : *json_action_fields_list_) {
+        if (entity["properties"].contains(field) && entity["properties"][field].is_string()) {
+            const std::string& field_value = entity["properties"][field].get_ref<const std::string&>();
 
-        for (const auto& field : *json_action_fields_list_) {
-            if (entity["properties"].contains(field) && entity["properties"][field].is_string()) {
-                std::string field_value = entity["properties"][field].get<std::string>();
+            if (!field_value.empty() && field_value.front() == '{' && field_value.back() == '}') {
+                json parsed_json;
 
-                if (!field_value.empty() && field_value.front() == '{' && field_value.back() == '}') {
-                    try {
-                        json parsed_json = json::parse(field_value);
-                        entity["properties"][field] = parsed_json;
-                    } catch (const json::exception&) {
-                        std::cerr << "Warning: Could not parse field '" << field << "' in entity." << std::endl;
-                    }
+                if (json_reader_.parse(field_value, parsed_json)) {
+                    entity["properties"][field] = std::move(parsed_json);
+                } else {
+                    std::cerr << "Warning: Could not parse field '" << field << "' in entity." << std::endl;
                 }
             }
         }
     }
 }
 
-bool ResponseHelper::validateJson(const json& dblf) {
-    if (!dblf.contains("entities") || !dblf["entities"].is_array()) {
-        std::cerr << "Error: JSON does not contain 'entities' array." << std::endl;
-        return false;
-    }
-    return true;
+void ResponseHelper::setWriterOptions(const EntityFileWriterOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    writer_options_ = options;
+}
+
+void ResponseHelper::setOutputLayout(const std::string& mode, bool merge) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    layout_mode_ = mode;
+    layout_merge_ = merge;
 }
 
-void ResponseHelper::printToConsole(const json& dblf) {
-    std::cout << dblf.dump(4) << std::endl;
+void ResponseHelper::setArchive(ArchiveWriter* archive) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    archive_ = archive;
 }
 
-bool ResponseHelper::saveToFile(const json& dblf) {
-    auto subfolder_path = prepareDirectory(json_subfolder_);
+bool ResponseHelper::saveToFile(json&& entity) {
+    std::lock_guard<std::mutex> lock(mutex_);
 
-    for (const auto& entity : dblf["entities"]) {
-        if (!entity["properties"].contains("Id")) {
-            std::cerr << "Error: Entity does not contain 'Id' property." << std::endl;
-            continue;
+    if (!file_writer_) {
+        // Members of an archive are named <JSON subfolder>/<Id>.json; its index replaces the fan-out
+        if (!archive_) {
+            json_layout_ = std::make_unique<OutputLayout>(layout_mode_, prepareDirectory(json_subfolder_), layout_merge_);
         }
 
-        std::string id = entity["properties"]["Id"].get<std::string>();
-        fs::path file_path = subfolder_path / (id + ".json");
-        if (!writeToFile(file_path, entity)) return false;
+        EntityFileWriterOptions options = writer_options_;
+        options.archive = archive_;
+        file_writer_ = std::make_unique<EntityFileWriter>(options);
     }
-    return true;
-}
 
-bool ResponseHelper::writeToFile(const fs::path& file_path, const json& entity) {
-    std::ofstream out_file(file_path);
-    if (!out_file) {
-        std::cerr << "Error: Could not create file " << file_path << std::endl;
-        return false;
+    if (!entity.contains("properties") || !entity["properties"].contains("Id")) {
+        std::cerr << "Error: Entity does not contain 'Id' property." << std::endl;
+        return true;
     }
-    out_file << entity.dump(4);
-    return true;
+
+    std::string id = entity["properties"]["Id"].get<std::string>();
+    fs::path file_path = json_layout_ ? json_layout_->place(id, id + ".json") : fs::path(json_subfolder_) / (id + ".json");
+    file_writer_->write(id, std::move(file_path), std::move(entity));
+
+    return file_writer_->getFailedCount() == 0;
+}
+
+bool ResponseHelper::finishFiles() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_writer_) return true;
+
+    bool index_written = !json_layout_ || json_layout_->finish();
+    return file_writer_->finish() && index_written;
 }
 
 } // namespace smax_ns
\ No newline at end of file
@@ -5,40 +5,34 @@
 #include <filesystem>
 #include <string>
 #include <mutex>
+#include <optional>
+#include <vector>
 #include <nlohmann/json.hpp>
 
+#include "EmbeddedJsonReader.h"
+#include "EntityFileWriter.h"
+#include "OutputLayout.h"
+
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
 namespace smax_ns {
 
-/**
- * @struct Attachment
- * @brief Represents an attachment with metadata.
- */
-struct Attachment {
-    std::string record_id;
-    std::string id;
-    std::string file_name;
-    std::string file_extension;
-    bool is_hidden;
-};
-
 /**
  * @class ResponseHelper
- * @brief A singleton class that provides JSON processing and attachment management functionalities.
+ * @brief Provides JSON processing and attachment management functionalities; each SMAXClient has its own instance.
  */
 class ResponseHelper {
 public:
     /**
-     * @brief Gets the singleton instance of ResponseHelper.
+     * @brief Creates an instance (one per SMAXClient).
      * @param full_path Base path for file storage.
      * @param json_subfolder Subfolder for JSON storage.
      * @param json_action_fields_list List of fields that need to be converted to JSON.
      * @param attachment_field Name of the attachment field.
-     * @return Reference to the singleton instance.
+     * @return The new instance.
      */
-    static ResponseHelper& getInstance(
+    static std::unique_ptr<ResponseHelper> create(
         const std::string& full_path,
         const std::string& json_subfolder,
         std::shared_ptr<std::vector<std::string>> json_action_fields_list,
@@ -46,37 +40,61 @@ public:
     );
 
     /**
-     * @brief Prints JSON to console of file.
-     * @param json_str JSON string.
-     * @param output_method output method (console or file).
-     * @return true or false.
+     * @brief Converts fields (json in string format, defined in json_action_fields_list) of an entity into json objects.
+     * @param entity entity of an EMS response.
+     */
+    void convertFieldsToJson(json& entity);
+
+    /**
+     * @brief Sets how saveToFile() writes files; must be called before the first saveToFile().
+     * @param options writer settings.
+     */
+    void setWriterOptions(const EntityFileWriterOptions& options);
+
+    /**
+     * @brief Sets the folder layout of saveToFile(); must be called before the first saveToFile().
+     * @param mode flat, prefix or hash (see OutputLayout).
+     * @param merge keep the Ids of an existing index (incremental runs).
+     */
+    void setOutputLayout(const std::string& mode, bool merge = false);
+
+    /**
+     * @brief Makes saveToFile() add the files to an archive instead of the JSON subfolder;
+     * must be called before the first saveToFile().
+     * @param archive the archive, which must outlive finishFiles().
+     */
+    void setArchive(ArchiveWriter* archive);
+
+    /**
+     * @brief Queues an entity to be saved in <Id>.json of the JSON subfolder (or of its
+     * fan-out folder, see setOutputLayout()).
+     * @param entity entity of an EMS response.
+     * @return false if a file queued earlier could not be written.
      */
-    bool dumpJson(const std::string& json_str, const std::string& output_method);
+    bool saveToFile(json&& entity);
 
     /**
-     * @brief Prints JSON to console of file.
-     * @param dblf JSON object.
-     * @param output_method output method (console or file).
-     * @return true or false.
+     * @brief Waits until the queued entities are saved.
+     * @return false if any file could not be written.
      */
-    bool dumpJson(json dblf, const std::string& output_method);
+    bool finishFiles();
 
     /**
-     * @brief Prints an attchment section (JSON string) to console.
-     * @param json_str attachment section.
+     * @brief Prints attachment data to console.
+     * @param attachments attachments.
      */
-    void printAttachmentsConsole(const std::string& json_str);
+    void printAttachmentsConsole(const std::vector<Attachment>& attachments);
 
     /**
-     * @brief Returns pointer to a vector contains attachment data (Attachment) .
-     * @param jsonString attachment section.
-     * @return vector of Attachment elements.
+     * @brief Adds the attachments of an entity (attachment field) to a vector.
+     * @param entity entity of an EMS response.
+     * @param attachments receives Attachment elements.
      */
-    std::shared_ptr<std::vector<Attachment>> getAttachmentInfo(const std::string& jsonString);
+    void getAttachmentInfo(const json& entity, std::vector<Attachment>& attachments);
 
     /**
      * @brief Preparation of directory structure.
-     * @param subfolder_name subfolder of the folder defined in full_path of the method getInstance.
+     * @param subfolder_name subfolder of the folder defined in full_path of the method create.
      * @return path.
      */
     fs::path prepareDirectory(const std::string& subfolder_name);
@@ -87,6 +105,13 @@ private:
     std::mutex mutex_;
     std::shared_ptr<std::vector<std::string>> json_action_fields_list_;
     std::string attachment_field_;
+    std::string layout_mode_ = "flat";
+    bool layout_merge_ = false;
+    std::unique_ptr<OutputLayout> json_layout_;  ///< Layout of the JSON subfolder, created by the first saveToFile()
+    EmbeddedJsonReader json_reader_;        ///< Parses the JSON documents embedded in fields
+    EntityFileWriterOptions writer_options_;
+    ArchiveWriter* archive_ = nullptr;      ///< Receives the JSON files when set
+    std::unique_ptr<EntityFileWriter> file_writer_;  ///< Created by the first saveToFile()
 
     explicit ResponseHelper(
         const std::string& base_path,
@@ -97,41 +122,6 @@ private:
 
     ResponseHelper(const ResponseHelper&) = delete;
     ResponseHelper& operator=(const ResponseHelper&) = delete;
-
-    /**
-     * @brief Converts field (json is string format, defined in json_action_fields_list) into a json object.
-     * @param dblf main json.
-     * @return true or false.
-     */
-    void convertFieldsToJson(json& dblf);
-
-    /**
-     * @brief Checks that json contains the element entities and entities is an array.
-     * @param dblf json to check.
-     * @return true or false.
-     */
-    bool validateJson(const json& dblf);
-
-    /**
-     * @brief Prints JSON to console.
-     * @param dblf json to check.
-     */
-    void printToConsole(const json& dblf);
-
-    /**
-     * @brief Saves JSON field in a text file.
-     * @param dblf json to save.
-     * @return true or false.
-     */
-    bool saveToFile(const json& dblf);
-
-    /**
-     * @brief Writes JSON element to a file.
-     * @param file_path full file name.
-     * @param entity json element.
-     * @return true or false.
-     */
-    bool writeToFile(const fs::path& file_path, const json& entity);
 };
 
 } // namespace smax_ns
\ No newline at end of file
@@ -1,13 +1,23 @@
 #include <boost/asio.hpp>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <future>
+#include <iomanip>
+#include <map>
 #include <nlohmann/json.hpp>
+#include <set>
 #include <sstream>
 
+#include "../RestClient/InFlightLimiter.h"
 #include "../RestClient/RestClient.h"
 #include "../Parser/Parser.h"
 #include "../utils/utils.h"
+#include "AttachmentDownloader.h"
+#include "AttachmentManifest.h"
+#include "AttachmentStore.h"
+#include "BulkJournal.h"
+#include "BulkLoader.h"
 #include "ConsoleSpinner.h"
 #include "SMAXClient.h"
 
@@ -26,16 +36,69 @@ SMAXClient& SMAXClient::getInstance(const ConnectionParameters& connection_props
     return *instance_;
 }
 
-SMAXClient::SMAXClient(const ConnectionParameters& connection_props)
+std::unique_ptr<SMAXClient> SMAXClient::create(const ConnectionParameters& connection_props,
+                                               std::shared_ptr<AsyncRuntime> runtime,
+                                               std::shared_ptr<TokenManager> token_manager,
+                                               std::shared_ptr<ResponseCache> cache) {
+    return std::unique_ptr<SMAXClient>(new SMAXClient(connection_props, std::move(runtime), std::move(token_manager),
+                                                      std::move(cache)));
+}
+
+SMAXClient::SMAXClient(const ConnectionParameters& connection_props,
+                       std::shared_ptr<AsyncRuntime> runtime,
+                       std::shared_ptr<TokenManager> token_manager,
+                       std::shared_ptr<ResponseCache> cache)
     : connection_props_(connection_props),
-      response_helper_(nullptr) {
+      response_helper_(nullptr),
+      runtime_(runtime ? std::move(runtime)
+                       : std::make_shared<AsyncRuntime>(connection_props.getIoThreads(),
+                                                        std::chrono::seconds(connection_props.getRequestTimeout()))),
+      token_manager_(token_manager ? std::move(token_manager) : std::make_shared<TokenManager>()),
+      cache_(std::move(cache)) {
+    // The first client of a process configures the shared token
+    std::shared_ptr<TokenCache> token_cache;
+    if (!connection_props_.getTokenCache().empty()) {
+        token_cache = std::make_shared<TokenCache>(connection_props_.getTokenCache(), connection_props_.getHost(),
+                                                   connection_props_.getTenant(), connection_props_.getUserName());
+    }
+    token_manager_->configure(makeAuthenticator(), std::move(token_cache));
+
+    if (!cache_ && connection_props_.getCacheTtl() > 0) {
+        cache_ = std::make_shared<ResponseCache>(fs::path(connection_props_.getOutputFolder()) / ResponseCache::FOLDER,
+                                                 std::chrono::seconds(connection_props_.getCacheTtl()),
+                                                 connection_props_.getCacheEntries());
+    }
+
+    auto action = connection_props_.getAction();
+    bool incremental = !connection_props_.getSinceState().empty();
+
+    if (incremental && (action == Action::GET || action == Action::JSON || action == Action::GETATTACHMENTS)) {
+        sync_state_ = std::make_unique<SyncState>(connection_props_.getSinceState(), connection_props_.getEntity(),
+                                                  connection_props_.getFilter());
+    }
+
     if (connection_props_.getAction() == Action::JSON || connection_props_.getAction() == Action::GETATTACHMENTS ) {
-        response_helper_ = &ResponseHelper::getInstance(
+        // Every client owns its helper: the jobs of one process write to different folders
+        response_helper_ = ResponseHelper::create(
             connection_props_.getOutputFolder(),
             connection_props_.getJsonActionOutputFolder(),
             connection_props_.getJsonActionFieldsList(),
             connection_props_.getAttActionField()
         );
+
+        EntityFileWriterOptions writer_options;
+        writer_options.threads = connection_props_.getJsonWriteThreads();
+        writer_options.max_outstanding = connection_props_.getJsonMaxOutstanding();
+        writer_options.compact = connection_props_.isJsonCompact();
+        writer_options.durable = connection_props_.isJsonDurable();
+        response_helper_->setWriterOptions(writer_options);
+        // Incremental runs add their records to the existing output tree
+        response_helper_->setOutputLayout(connection_props_.getOutputLayout(), incremental);
+    }
+
+    if (connection_props_.getAction() == Action::GET && connection_props_.getOutputFile().empty() &&
+        connection_props_.getOutputFormat() != "pretty") {
+        ConsoleSpinner::setOutput(std::cerr);
     }
 }
 
@@ -102,15 +165,25 @@ std::string SMAXClient::getEmsJsonUrl() const {
 
 std::string SMAXClient::getEmsUrl(std::string layout) const {
     std::ostringstream url;
-    url << getEmsBaseUrl() << "?layout=" << layout;
-    
-    if (!connection_props_.getFilter().empty()) {
-        url << "&filter=" << url_encode(connection_props_.getFilter());
+    // An incremental run needs LastUpdateTime of every record for its next watermark
+    url << getEmsBaseUrl() << "?layout=" << (sync_state_ ? SyncState::withField(layout) : layout);
+
+    const std::string filter = sync_state_ ? sync_state_->getFilter() : connection_props_.getFilter();
+    if (!filter.empty()) {
+        url << "&filter=" << url_encode(filter);
     }
 
     return url.str();
 }
 
+std::string SMAXClient::getEmsPageUrl(std::string layout, std::size_t skip, std::size_t size) const {
+    std::ostringstream url;
+    // Without an order EMS may sort the pages differently, so records could be repeated or missed
+    url << getEmsUrl(layout) << "&order=" << url_encode("Id asc") << "&skip=" << skip << "&size=" << size;
+
+    return url.str();
+}
+
 std::string SMAXClient::getEmsBaseUrl() const {
     std::ostringstream url;
     url << getBaseRestUrl() << "/" << connection_props_.getEntity();
@@ -125,7 +198,12 @@ std::string SMAXClient::getBulkPostUrl() const {
 }
 
 std::string SMAXClient::doAction() {
-    if (connection_props_.isVerbose()) return getRequestInfo();
+    succeeded_ = false;
+
+    if (connection_props_.isVerbose()) {
+        succeeded_ = true;
+        return getRequestInfo();
+    }
 
     switch (connection_props_.getAction()) {
     case Action::GET:
@@ -150,51 +228,113 @@ std::string SMAXClient::doAction() {
     return "Unsupported action";
 }
 
+bool SMAXClient::isSucceeded() const {
+    return succeeded_;
+}
+
+const ResponseCache* SMAXClient::getCache() const {
+    return cache_.get();
+}
+
 std::string SMAXClient::processGetAttachments() {
     bool isSuccess;
     int status_code;
     std::string result = "ATTACHMENTS";
 
-    auto data = sendRequest(getEmsUrl(connection_props_.getAttActionField()), "", false, status_code);
+    std::vector<Attachment> attachments;
+    json rest;
+
+    if (!response_helper_) return result;
 
-    isSuccess = saveAttachmentsToDirectory(data);
+    if (!streamEntities(connection_props_.getAttActionField(), [&](json& entity) {
+            response_helper_->getAttachmentInfo(entity, attachments);
+        }, rest, status_code)) {
+        return result;
+    }
 
-    if (isSuccess) result = "Attachments are analyzed";
+    isSuccess = saveAttachmentsToDirectory(attachments);
+
+    if (isSuccess && saveSyncState()) {
+        succeeded_ = true;
+        result = "Attachments are analyzed";
+    }
 
     return result;
 }
 
-bool SMAXClient::saveAttachmentsToDirectory(const std::string& data) const {
+bool SMAXClient::saveAttachmentsToDirectory(const std::vector<Attachment>& attachments) const {
     if (!response_helper_) {
         return false;
     }
 
     if (connection_props_.getAttActionOutput() == "console") {
-        response_helper_->printAttachmentsConsole(data);
+        response_helper_->printAttachmentsConsole(attachments);
     } if (connection_props_.getAttActionOutput() == "file") {
-        doSaveAttachments(data);
+        return doSaveAttachments(attachments);
     }
 
     return true;
 }
 
-bool SMAXClient::saveJsonToDirectory(const std::string& data) const {
-    if (response_helper_) {
-        return response_helper_->dumpJson(data, connection_props_.getJsonActionOutput());
-    }
-    return false;
-}
-
 std::string SMAXClient::processJsonAction() {
-    bool isSuccess;
+    bool isSuccess = true;
     int status_code;
     std::string result = "JSON";
-    
-    auto data = sendRequest(getEmsUrl(connection_props_.getJsonActionField()), "", false, status_code);
 
-    isSuccess = saveJsonToDirectory(data);
+    const auto& output_method = connection_props_.getJsonActionOutput();
+
+    if (!response_helper_) return result;
+
+    if (output_method != "console" && output_method != "file") {
+        std::cerr << "Error: Invalid output method." << std::endl;
+        return result;
+    }
+
+    std::unique_ptr<ArchiveWriter> archive;
+    if (output_method == "file" && !connection_props_.getOutputArchive().empty()) {
+        try {
+            archive = std::make_unique<ArchiveWriter>(connection_props_.getOutputArchive());
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return result;
+        }
+        response_helper_->setArchive(archive.get());
+    }
+
+    // The console text is printed after the spinner has finished
+    std::ostringstream console;
+    PrettyDocumentWriter writer(console);
+    json rest;
+
+    bool received = streamEntities(connection_props_.getJsonActionField(), [&](json& entity) {
+        response_helper_->convertFieldsToJson(entity);
+
+        if (output_method == "console") {
+            writer.addEntity(entity);
+        } else if (isSuccess) {
+            isSuccess = response_helper_->saveToFile(std::move(entity));
+        }
+    }, rest, status_code);
+
+    // Files are written in the background; wait for the ones still queued
+    if (output_method == "file") isSuccess = response_helper_->finishFiles() && isSuccess;
+    if (archive) {
+        isSuccess = archive->finish(connection_props_.isJsonDurable()) && isSuccess;
+        // One write per line keeps the lines of concurrent jobs (--jobs) apart
+        std::cout << "Archive: " + archive->getPath().string() + " (" + std::to_string(archive->getMemberCount()) + " files)\n";
+    }
+
+    if (!received) return result;
 
-    if (isSuccess) result = "JSON field is printed";
+    if (output_method == "console") {
+        writer.finish(rest);
+        std::cout << console.str() << std::endl;
+    }
+
+    if (isSuccess && saveSyncState()) {
+        succeeded_ = true;
+        result = "JSON field is printed";
+    }
 
     return result;
 }
@@ -263,6 +403,11 @@ std::string SMAXClient::getRequestInfo() const {
     oss << "3) Action: " << connection_props_.getActionAsString() << "\n"
         << "4) HTTP action: <" << http_action << ">\n";
 
+    if (!needs_post_body && connection_props_.getPageSize() > 0) {
+        oss << "   Paging: " << connection_props_.getPageSize() << " records per page (&skip=...&size=...), "
+            << connection_props_.getPageConcurrency() << " pages in parallel\n";
+    }
+
     if (needs_post_body) {
         if (action == smax_ns::Action::CREATE || action == smax_ns::Action::UPDATE) {
             Parser parser(connection_props_.getCSVfilename());
@@ -277,20 +422,142 @@ std::string SMAXClient::getRequestInfo() const {
 }
 
 std::string SMAXClient::postData() {
-    int status_code;
     Parser parser(connection_props_.getCSVfilename());
-    auto postBody = parser.parseCSV(connection_props_.getEntity(), connection_props_.getActionAsString()).dump();
 
-    return sendRequest(getBulkPostUrl(), postBody, true, status_code);
+    updateToken();
+
+    std::ostringstream oss;
+    oss << "Sending " << connection_props_.getActionAsString() << " request ";
+    ConsoleSpinner spinner(oss.str());
+
+    if (!token_info_.has_value() || token_info_->token == "ERROR") {
+        return "ERROR";
+    }
+
+    auto url = getBulkPostUrl();
+
+    BulkLoader loader(
+        runtime_->getIoContext(),
+        [this, url](const std::string& body, AsyncRuntime::Callback callback) {
+            send_authorized(http::verb::post, url, body, {}, std::move(callback));
+        },
+        connection_props_.getActionAsString(),
+        connection_props_.getBulkBatchSize(),
+        connection_props_.getBulkConcurrency(),
+        connection_props_.getBulkRetries());
+
+    BulkJournal journal(connection_props_.getCSVfilename(), connection_props_.getEntity(),
+                        connection_props_.getActionAsString(), connection_props_.isResume());
+    loader.setJournal(&journal);
+    loader.setRejectFile(connection_props_.getCSVfilename() + ".rejected.csv", parser.readHeader());
+
+    if (journal.getConfirmedCount() > 0 || journal.getUnknownCount() > 0) {
+        spinner.setStatus("resuming, " + std::to_string(journal.getConfirmedCount()) + " records already accepted, " +
+                          std::to_string(journal.getUnknownCount()) + " of unknown outcome not sent again");
+    }
+
+    parser.forEachEntity(connection_props_.getEntity(), connection_props_.getCsvThreads(), [&](ParsedRow& row) {
+        loader.add(row);
+    }, journal.getResumeOffset(), journal.getResumeRow());
+
+    auto report = loader.finish();
+
+    spinner.setStatus(report["meta"]["completion_status"].get<std::string>() + " (" +
+                      std::to_string(loader.getBatchCount() - loader.getFailedBatchCount()) + " of " +
+                      std::to_string(loader.getBatchCount()) + " batches accepted, " +
+                      std::to_string(loader.getRejectedCount()) + " records rejected, " +
+                      std::to_string(loader.getUnknownCount()) + " of unknown outcome)");
+
+    succeeded_ = report["meta"]["completion_status"] == "OK";
+    return report.dump(4);
 }
 
 std::string SMAXClient::getData() {
     int status_code;
-    auto result = sendRequest(getEmsUrl(connection_props_.getLayout()), "", false, status_code);
-    return result;
+    const auto& format = connection_props_.getOutputFormat();
+    const auto& file_name = connection_props_.getOutputFile();
+    json rest;
+
+    // Pretty text for the console is returned and printed after the spinner has finished
+    if (file_name.empty() && format == "pretty") {
+        std::ostringstream out;
+        PrettyDocumentWriter writer(out);
+
+        if (!streamEntities(connection_props_.getLayout(), [&](json& entity) { writer.addEntity(entity); }, rest, status_code)) {
+            return "ERROR";
+        }
+
+        writer.finish(rest);
+        succeeded_ = saveSyncState();
+        return out.str();
+    }
+
+    std::ofstream file;
+    if (!file_name.empty()) {
+        file.open(file_name, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to open output file: " << file_name << std::endl;
+            return "ERROR";
+        }
+    }
+
+    // Otherwise every entity is written as soon as it is parsed
+    std::ostream& out = file_name.empty() ? std::cout : file;
+    auto writer = EntityWriter::create(format, out, file_name.empty());
+    std::size_t count = 0;
+
+    bool received = streamEntities(connection_props_.getLayout(), [&](json& entity) {
+        writer->addEntity(entity);
+        ++count;
+    }, rest, status_code);
+
+    if (received) {
+        writer->finish(rest);
+        if (format != "ndjson") out << "\n";
+    }
+    out.flush();
+
+    if (file_name.empty()) {
+        // std::cout carries the results only, see the constructor
+        if (!received) std::cerr << "ERROR" << std::endl;
+        else succeeded_ = saveSyncState();
+        return "";
+    }
+
+    if (!file) {
+        std::cerr << "Failed to write output file: " << file_name << std::endl;
+        return "ERROR";
+    }
+
+    if (received) succeeded_ = saveSyncState();
+
+    return received ? std::to_string(count) + " records written to " + file_name : "ERROR";
+}
+
+bool SMAXClient::queryEntities(const EntityConsumer& consumer, json& rest, int& status_code) {
+    succeeded_ = streamEntities(connection_props_.getLayout(), consumer, rest, status_code);
+    return succeeded_;
+}
+
+bool SMAXClient::saveSyncState() const {
+    if (!sync_state_) return true;
+
+    // std::cout may carry GET results
+    std::cerr << "Records changed since the last run: " << sync_state_->getRecordCount() << "\n";
+    return sync_state_->save();
 }
 
-std::string SMAXClient::sendRequest(const std::string& endpoint, const std::string& body, bool isPost, int & result_status_code) {
+bool SMAXClient::streamEntities(const std::string& layout, const EntityConsumer& entity_consumer, json& rest, int& result_status_code) {
+    std::size_t page_size = connection_props_.getPageSize();
+
+    EntityConsumer consumer = entity_consumer;
+    if (sync_state_) {
+        // Records of the overlap with the previous run are dropped unless they changed since
+        consumer = [this, &entity_consumer](json& entity) {
+            if (sync_state_->observe(entity)) entity_consumer(entity);
+        };
+    }
+
     updateToken();
 
     std::ostringstream oss;
@@ -298,34 +565,116 @@ std::string SMAXClient::sendRequest(const std::string& endpoint, const std::stri
     ConsoleSpinner spinner(oss.str());
 
     if (!token_info_.has_value() || token_info_->token == "ERROR") {
-        return "ERROR";
+        return false;
     }
 
-    std::future<std::string> future = std::async(std::launch::async, [&] {
-        std::string result;
-        int status_code;
+    EntityStreamParser parser(consumer);
 
-        bool success = isPost ? request_post(endpoint, getPort(), body, result, status_code)
-                              : request_get(endpoint, getPort(), result, status_code);
+    std::promise<RestResponse> first_response;
+    request_ems_page(page_size == 0 ? getEmsUrl(layout) : getEmsPageUrl(layout, 0, page_size),
+                     [&first_response](RestResponse response) { first_response.set_value(std::move(response)); });
 
-        result_status_code = status_code;
-        spinner.setStatus(std::to_string(status_code));
+    RestResponse response = first_response.get_future().get();
+    std::string first_page = std::move(response.body);
+    bool success = response.success;
+    result_status_code = response.status_code;
 
-        return (success && status_code == 200) ? parseJson(result) : "ERROR";
-    });
+    if (!success || result_status_code != 200) {
+        spinner.setStatus(std::to_string(result_status_code));
+        return false;
+    }
 
-    return future.get();
-}
+    if (!parser.parse(first_page)) {
+        std::cerr << "Ошибка парсинга JSON: " << parser.getError() << std::endl;
+        return false;
+    }
+
+    first_page = std::string();
+    rest = parser.getRest();
+
+    if (page_size == 0) {
+        spinner.setStatus(std::to_string(result_status_code));
+        return true;
+    }
+
+    std::size_t received = parser.getEntityCount();
+    std::size_t total = rest.contains("meta") && rest["meta"].is_object() ? rest["meta"].value("total_count", std::size_t{0}) : 0;
+
+    // The server may cap the page size, so the next pages are requested by the size that was actually returned
+    std::size_t step = std::min(page_size, received);
+    std::size_t pages = step == 0 || total <= received ? 1 : 1 + (total - received + step - 1) / step;
+
+    struct Page {
+        bool ready = false;
+        RestResponse response;
+    };
+
+    std::vector<Page> results(pages);
+    std::mutex results_mutex;
+    std::condition_variable results_ready;
+    std::size_t concurrency = std::max<std::size_t>(connection_props_.getPageConcurrency(), 1);
+    InFlightLimiter limiter(concurrency);
+
+    auto fetch = [&](std::size_t page) {
+        limiter.acquire();
+
+        request_ems_page(getEmsPageUrl(layout, received + (page - 1) * step, step),
+            [&, page](RestResponse response) {
+                {
+                    std::lock_guard<std::mutex> lock(results_mutex);
+                    results[page].response = std::move(response);
+                    results[page].ready = true;
+                }
+                results_ready.notify_all();
+                limiter.release();
+            });
+    };
 
+    std::size_t next_page = 1;
+    bool complete = true;
 
-std::string SMAXClient::parseJson(const std::string& data) {
+    // The consumer may throw to cancel the query; the callbacks in flight refer to this frame
     try {
-        json parsed_json = json::parse(data);
-        return parsed_json.dump(4);
-    } catch (const std::exception& e) {
-        std::cerr << "Ошибка парсинга JSON: " << e.what() << std::endl;
-        return "ERROR";
+        for (std::size_t page = 1; page < pages; ++page) {
+            // Keep the window of pages in flight full while this page is consumed
+            while (next_page < pages && next_page < page + concurrency) {
+                fetch(next_page++);
+            }
+
+            RestResponse response;
+            {
+                std::unique_lock<std::mutex> lock(results_mutex);
+                results_ready.wait(lock, [&] { return results[page].ready; });
+                response = std::move(results[page].response);
+            }
+
+            if (!response.success || response.status_code != 200) {
+                result_status_code = response.status_code;
+                spinner.setStatus(std::to_string(result_status_code) + " (page " + std::to_string(page + 1) + " of " + std::to_string(pages) + ")");
+                complete = false;
+                break;
+            }
+
+            if (!parser.parse(response.body)) {
+                std::cerr << "Ошибка парсинга JSON: " << parser.getError() << std::endl;
+                complete = false;
+                break;
+            }
+        }
+    } catch (...) {
+        limiter.wait();
+        throw;
+    }
+
+    // The callbacks refer to this frame
+    limiter.wait();
+
+    if (complete) {
+        spinner.setStatus(std::to_string(result_status_code) + " (" + std::to_string(pages) + " pages, " +
+                          std::to_string(parser.getEntityCount()) + " records)");
     }
+
+    return complete;
 }
 
 int SMAXClient::getPort() const {
@@ -334,17 +683,20 @@ int SMAXClient::getPort() const {
 }
 
 void SMAXClient::updateToken() {
-    auto now = std::chrono::system_clock::now();
+    token_info_ = token_manager_->get();
 
-    if (!token_info_.has_value() || 
-        std::chrono::duration_cast<std::chrono::minutes>(now - token_info_->creation_time).count() > TOKEN_LIFE_TIME_MINUTES) {
-        
-        if (getToken() == "ERROR") {
-            std::cerr << "Ошибка получения токена" << std::endl;
-        }
+    if (!token_info_.has_value()) {
+        std::cerr << "Ошибка получения токена" << std::endl;
     }
 }
 
+std::string SMAXClient::currentToken() const {
+    auto token = token_manager_->peek();
+    if (token.has_value()) return *token;
+
+    return token_info_.has_value() ? token_info_->token : "";
+}
+
 std::string SMAXClient::getAuthBody() const {
     std::ostringstream json_stream;
     json_stream << R"({"login":")" << connection_props_.getUserName() << R"(", "password":")" << connection_props_.getPassword() << R"("})";
@@ -353,118 +705,245 @@ std::string SMAXClient::getAuthBody() const {
 }
 
 std::string SMAXClient::getToken() {
-    ConsoleSpinner spinner("Getting a new token");
+    updateToken();
 
-    std::string json_body = getAuthBody();
-    auto endpoint = getAuthorizationUrl();
-    auto port = connection_props_.getSecurePort();
+    return token_info_.has_value() ? token_info_->token : "ERROR";
+}
 
-    std::string token;
-    int status_code;
+TokenManager::Authenticator SMAXClient::makeAuthenticator() const {
+    return [runtime = runtime_, host = connection_props_.getHost(), port = connection_props_.getSecurePort(),
+            endpoint = getAuthorizationUrl(), body = getAuthBody()]() -> std::optional<TokenInfo> {
+        ConsoleSpinner spinner("Getting a new token");
 
-    bool success = auth_post(endpoint, port, json_body, token, status_code);
+        auto response = runtime->request(http::verb::post, host, port, endpoint, body, {}).get();
 
-    spinner.setStatus(std::to_string(status_code));
+        spinner.setStatus(std::to_string(response.status_code));
 
-    if (!success || status_code != 200) {
-        token_info_.reset();
-        return "ERROR";
-    }
+        if (!response.success || response.status_code != 200) {
+            return std::nullopt;
+        }
+
+        return TokenInfo{response.body, std::chrono::system_clock::now()};
+    };
+}
 
-    token_info_ = TokenInfo{token, std::chrono::system_clock::now()};
 
-    return token;
+void SMAXClient::perform_request_async(http::verb method, const std::string& endpoint, uint16_t port,
+                                       const std::string& body,
+                                       const std::map<std::string, std::string>& headers,
+                                       AsyncRuntime::Callback callback) const {
+    runtime_->request(method, connection_props_.getHost(), port, endpoint, body, headers, std::move(callback));
 }
 
+void SMAXClient::send_authorized(http::verb method, const std::string& endpoint, const std::string& body,
+                                 const std::map<std::string, std::string>& headers,
+                                 AsyncRuntime::Callback callback) const {
+    send_with_token([this, method, endpoint, body](const std::map<std::string, std::string>& request_headers,
+                                                   AsyncRuntime::Callback done) {
+        perform_request_async(method, endpoint, getPort(), body, request_headers, std::move(done));
+    }, headers, std::move(callback));
+}
 
-bool SMAXClient::perform_request(http::verb method, const std::string& endpoint, uint16_t port,
-                                 const std::string& body, std::string& result,
-                                 const std::map<std::string, std::string>& headers, int& status_code) const {
-    boost::asio::io_context ioc;
-    boost::asio::ssl::context ctx(boost::asio::ssl::context::tls_client);
-    std::promise<std::tuple<bool, std::string, int>> promise;
-    auto future = promise.get_future();
-    auto host = connection_props_.getHost();
+void SMAXClient::download_authorized(const std::string& target, const std::string& file_path,
+                                     AsyncRuntime::Callback callback) const {
+    // The file is truncated when the download is sent once more
+    send_with_token([this, target, file_path](const std::map<std::string, std::string>& request_headers,
+                                              AsyncRuntime::Callback done) {
+        runtime_->download(connection_props_.getHost(), getPort(), target, file_path, request_headers, std::move(done));
+    }, {}, std::move(callback));
+}
 
-    try {
-        auto client = std::make_shared<RestClient>(ioc, ctx, host, std::to_string(port));
-
-        client->run(endpoint, method, body, 
-            [&promise](const std::string& response, const boost::system::error_code& ec, int http_status) {
-                if (!ec) {
-                    promise.set_value({true, response, http_status});
-                } else {
-                    std::cerr << "Error: " << ec.message() << "\n";
-                    promise.set_value({false, "Ошибка запроса: " + ec.message(), http_status});
-                }
-            }, headers);
+void SMAXClient::send_with_token(Sender send, std::map<std::string, std::string> headers,
+                                 AsyncRuntime::Callback callback) const {
+    std::string token = currentToken();
+    headers["Cookie"] = "SMAX_AUTH_TOKEN=" + token;
+
+    send(headers, [this, send, headers, token, callback](RestResponse response) mutable {
+        if (response.status_code != 401) {
+            callback(std::move(response));
+            return;
+        }
+
+        // The renewal is shared with the other requests rejected with this token;
+        // the caller waits for the callback, so the client outlives it
+        token_manager_->renew(token, [send, headers, callback,
+                                      response = std::move(response)](std::optional<std::string> renewed) mutable {
+            if (!renewed) {
+                callback(std::move(response));
+                return;
+            }
+
+            headers["Cookie"] = "SMAX_AUTH_TOKEN=" + *renewed;
+            send(headers, std::move(callback));
+        });
+    });
+}
 
-        ioc.run();
-    } catch (const std::exception& e) {
-        std::cerr << "Exception: " << e.what() << "\n";
-        promise.set_value({false, "Исключение: " + std::string(e.what()), 0});
+void SMAXClient::request_ems_page(const std::string& endpoint, AsyncRuntime::Callback callback) const {
+    if (!cache_) {
+        send_authorized(http::verb::get, endpoint, "", {}, std::move(callback));
+        return;
     }
 
-    auto [success, response, http_status] = future.get();
-    result = response;
-    status_code = http_status;
+    // Users may see different records, so the user is part of the key
+    std::string key = connection_props_.getUserName() + "@" + endpoint;
+    auto cached = cache_->find(key);
 
-    return success;
-}
+    if (cached && cache_->isFresh(*cached)) {
+        cache_->countHit();
+        callback(RestResponse{true, std::move(cached->body), 200, cached->etag, cached->last_modified});
+        return;
+    }
 
-bool SMAXClient::request_get(const std::string& endpoint, uint16_t port, std::string& result, int& status_code) const {
-    return perform_request(http::verb::get, endpoint, port, "", result, {{"Cookie", "SMAX_AUTH_TOKEN=" + token_info_->token}}, status_code);
-}
+    std::map<std::string, std::string> headers;
+    if (cached && !cached->etag.empty()) headers["If-None-Match"] = cached->etag;
+    if (cached && !cached->last_modified.empty()) headers["If-Modified-Since"] = cached->last_modified;
 
-bool SMAXClient::auth_post(const std::string& endpoint, uint16_t port, const std::string& json_body, std::string& result, int& status_code) const {
-    return perform_request(http::verb::post, endpoint, port, json_body, result, {}, status_code);
-}
+    send_authorized(http::verb::get, endpoint, "", headers,
+        [cache = cache_, key, cached, callback](RestResponse response) {
+            if (response.success && response.status_code == 304 && cached) {
+                cache->countRevalidated();
+
+                ResponseCache::Entry entry = *cached;
+                if (!response.etag.empty()) entry.etag = response.etag;
+                if (!response.last_modified.empty()) entry.last_modified = response.last_modified;
+                cache->store(key, entry);
 
-bool SMAXClient::request_post(const std::string& endpoint, uint16_t port, const std::string& json_body, std::string& result, int& status_code) const {
-    return perform_request(http::verb::post, endpoint, port, json_body, result, {{"Cookie", "SMAX_AUTH_TOKEN=" + token_info_->token}}, status_code);
+                response.status_code = 200;
+                response.body = std::move(entry.body);
+            } else {
+                cache->countMiss();
+
+                if (response.success && response.status_code == 200) {
+                    cache->store(key, ResponseCache::Entry{response.body, response.etag, response.last_modified, {}});
+                }
+            }
+
+            callback(std::move(response));
+        });
 }
 
-bool SMAXClient::doSaveAttachments(const std::string& data) const {
-    auto attachment_folder = response_helper_->prepareDirectory(connection_props_.getAttActionOutputFolder());
-    auto attachments = response_helper_->getAttachmentInfo(data);
+bool SMAXClient::doSaveAttachments(const std::vector<Attachment>& attachments) const {
+    const auto& archive_path = connection_props_.getOutputArchive();
+
+    std::unique_ptr<ArchiveWriter> archive;
+    std::unique_ptr<OutputLayout> layout;
+    std::unique_ptr<AttachmentManifest> manifest;
+    std::unique_ptr<AttachmentStore> store;
+    fs::path parts_folder;
+
+    if (archive_path.empty()) {
+        auto attachment_folder = response_helper_->prepareDirectory(connection_props_.getAttActionOutputFolder());
+        layout = std::make_unique<OutputLayout>(connection_props_.getOutputLayout(), attachment_folder, sync_state_ != nullptr);
+        manifest = std::make_unique<AttachmentManifest>(attachment_folder);
+        if (connection_props_.isAttDedup()) store = std::make_unique<AttachmentStore>(attachment_folder);
+    } else {
+        try {
+            archive = std::make_unique<ArchiveWriter>(archive_path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        // Downloads are staged here until they are complete and appended to the archive
+        parts_folder = archive_path + ".parts";
+        fs::create_directories(parts_folder);
+    }
+
+    std::vector<DownloadJob> jobs;
+    jobs.reserve(attachments.size());
+
+    // An FRS file attached to several records is downloaded once and then linked or copied
+    std::map<std::string, fs::path> first_paths;
+    std::vector<std::pair<fs::path, fs::path>> repeats;
+
+    // Two attachments of a record may have the same file name; the later ones get their id appended
+    std::set<std::string> used_paths;
+    auto unique_path = [&used_paths](const fs::path& path, const std::string& id) {
+        if (used_paths.insert(path.generic_string()).second) return path;
+
+        fs::path renamed = path.parent_path() / (path.stem().string() + "_" + id + path.extension().string());
+        used_paths.insert(renamed.generic_string());
+        return renamed;
+    };
 
     size_t counter = 1;
-    
-    for (const auto& attachment : *attachments) {
+    size_t unchanged = 0;
+
+    for (const auto& attachment : attachments) {
         std::string file_name = !attachment.file_name.empty() ? attachment.file_name : "file_" + std::to_string(counter++);
 
-        std::ostringstream oss;
-        oss << "Saving file " << file_name;
-        ConsoleSpinner spinner(oss.str());
-        
-        std::string result;
-        std::string url= getFrsUrl(attachment.id);
-        int status_code = 0;
-
-        bool success = perform_request(http::verb::get, url, getPort(), "", result, {{"Cookie", "SMAX_AUTH_TOKEN=" + token_info_->token}}, status_code);
-        if (!success || status_code != 200) {
-            std::cerr << "File load error: " << url << " (HTTP " << status_code << ")\n";
-            continue;
-        }
+        if (archive) {
+            std::string member_name = unique_path(fs::path(connection_props_.getAttActionOutputFolder()) / attachment.record_id / file_name,
+                                                  attachment.id).generic_string();
+            jobs.push_back(DownloadJob{getFrsUrl(attachment.id), parts_folder / std::to_string(jobs.size()), attachment.record_id, member_name,
+                                       attachment.id, attachment.last_update_time});
+        } else {
+            fs::path file_path = unique_path(layout->place(attachment.record_id, attachment.record_id) / file_name, attachment.id);
 
-        std::string subfolder = attachment.record_id;
+            auto first = first_paths.emplace(attachment.id, file_path);
+            if (!first.second) {
+                repeats.emplace_back(first.first->second, std::move(file_path));
+                continue;
+            }
 
-        fs::path file_path = fs::path(attachment_folder) / subfolder / file_name;
-        fs::create_directories(file_path.parent_path());
+            if (!connection_props_.isAttRefresh() && manifest->isCurrent(attachment, file_path)) {
+                ++unchanged;
+                continue;
+            }
 
-        std::ofstream file(file_path, std::ios::binary);
-        if (!file) {
-            std::cerr << "File creation error: " << file_path << "\n";
-            continue;
+            jobs.push_back(DownloadJob{getFrsUrl(attachment.id), std::move(file_path), attachment.record_id, "",
+                                       attachment.id, attachment.last_update_time});
         }
+    }
+
+    if (layout) layout->finish();
+
+    // Every download takes the token of the moment, so a long batch survives a renewal
+    auto fetch = [this](const std::string& target, const std::string& file_path, AsyncRuntime::Callback callback) {
+        download_authorized(target, file_path, std::move(callback));
+    };
+
+    AttachmentDownloader downloader(fetch, connection_props_.getAttParallelism());
+    downloader.setArchive(archive.get());
+    downloader.setManifest(manifest.get());
+    downloader.setStore(store.get());
+
+    if (unchanged > 0) std::cout << "Unchanged files skipped: " + std::to_string(unchanged) + "\n";
 
-        file.write(result.data(), result.size());
-        file.close();
+    auto summary = downloader.run(jobs);
+    std::cout << AttachmentDownloader::formatSummary(summary) + "\n";
 
-        std::cout << "File is saved: " << file_path;
+    size_t repeats_failed = 0;
+    for (const auto& [source, target] : repeats) {
+        if (!AttachmentStore::duplicate(source, target, store != nullptr)) ++repeats_failed;
     }
 
-    return true;
+    if (!repeats.empty()) {
+        std::cout << "Files attached to several records, not downloaded again: " + std::to_string(repeats.size() - repeats_failed) +
+                     " of " + std::to_string(repeats.size()) + "\n";
+    }
+
+    if (store && store->getLinkedCount() > 0) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(2) << "Files linked to a stored copy: " << store->getLinkedCount()
+            << ", " << static_cast<double>(store->getSavedBytes()) / (1024.0 * 1024.0) << " MB saved\n";
+        std::cout << oss.str();
+    }
+
+    // Files saved before a failure are kept in the manifest
+    bool recorded = !manifest || manifest->save();
+
+    bool archived = true;
+    if (archive) {
+        archived = archive->finish();
+        std::cout << "Archive: " + archive_path + " (" + std::to_string(archive->getMemberCount()) + " files)\n";
+
+        std::error_code ec;
+        fs::remove_all(parts_folder, ec);
+    }
+
+    return summary.failed == 0 && repeats_failed == 0 && archived && recorded;
 }
 
 
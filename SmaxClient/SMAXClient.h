@@ -3,24 +3,18 @@
 #include <optional>
 #include <boost/beast/http.hpp>
 #include <memory>
+#include <mutex>
+#include "../RestClient/AsyncRuntime.h"
 #include "ConnectionProperties.h"
+#include "EntityStream.h"
+#include "ResponseCache.h"
 #include "ResponseHelper.h"
+#include "SyncState.h"
+#include "TokenCache.h"
+#include "TokenManager.h"
 
 namespace smax_ns {
 
-/**
- * @brief Constant that defines the token life time in minutes.
- */
-const short TOKEN_LIFE_TIME_MINUTES = 10;
-
-/**
- * @brief Structure to hold token information including the token string and its creation time.
- */
-struct TokenInfo {
-    std::string token; ///< The token string
-    std::chrono::system_clock::time_point creation_time; ///< The creation time of the token
-};
-
 /**
  * @brief A singleton class responsible for interacting with the SMAX system.
  * 
@@ -35,6 +29,19 @@ public:
      */
     static SMAXClient& getInstance(const ConnectionParameters& connection_props);
 
+    /**
+     * @brief Creates a client independent of the singleton (one per job of --jobs).
+     * @param connection_props Connection parameters of the job, which must outlive the client.
+     * @param runtime I/O threads and connection pool shared with the other jobs.
+     * @param token_manager Token shared with the other jobs.
+     * @param cache Response cache shared with the other jobs, or nullptr.
+     * @return The new client.
+     */
+    static std::unique_ptr<SMAXClient> create(const ConnectionParameters& connection_props,
+                                              std::shared_ptr<AsyncRuntime> runtime,
+                                              std::shared_ptr<TokenManager> token_manager,
+                                              std::shared_ptr<ResponseCache> cache = nullptr);
+
     /**
      * @brief Deleted copy constructor for SMAXClient.
      */
@@ -77,6 +84,15 @@ public:
      */
     std::string getEmsUrl(std::string layout) const;
 
+    /**
+     * @brief Get the EMS URL of one page of the result, ordered by Id.
+     * @param layout The layout.
+     * @param skip Number of records to skip.
+     * @param size Number of records in the page.
+     * @return std::string The EMS URL for the page.
+     */
+    std::string getEmsPageUrl(std::string layout, std::size_t skip, std::size_t size) const;
+
     /**
      * @brief Get the base EMS URL with layout contains set of JSON fields defined by parameters
      * @return std::string The base EMS URL.
@@ -101,6 +117,30 @@ public:
      */
     std::string doAction();
 
+    /**
+     * @brief Checks whether the last doAction() succeeded.
+     * @return bool True if all requests succeeded and all output was written.
+     */
+    bool isSucceeded() const;
+
+    /**
+     * @brief Streams the result of the GET query of the parameters (entity, layout, filter).
+     *
+     * Used by the query server (--serve), which writes the entities to its clients itself.
+     * @param consumer Receives the entities in result order on the calling thread; it may throw
+     * to cancel the query, and the exception is passed on once the pages in flight are answered.
+     * @param rest Receives the top-level members other than "entities" of the first page.
+     * @param status_code The HTTP status code of SMAX.
+     * @return bool True if all pages were received and parsed.
+     */
+    bool queryEntities(const EntityConsumer& consumer, json& rest, int& status_code);
+
+    /**
+     * @brief Get the response cache of the client.
+     * @return The cache, or nullptr if --cache-ttl is 0.
+     */
+    const ResponseCache* getCache() const;
+
     /**
      * @brief Get the current authorization token.
      * @return std::string The authorization token.
@@ -112,13 +152,24 @@ private:
     static std::unique_ptr<SMAXClient> instance_; ///< The singleton instance of the SMAXClient
     static std::once_flag init_flag_; ///< Flag to ensure initialization occurs only once
     std::optional<TokenInfo> token_info_; ///< Optional token information
-    ResponseHelper* response_helper_; ///< Response helper object for processing API responses
+    std::unique_ptr<ResponseHelper> response_helper_; ///< Response helper object for processing API responses
+    std::shared_ptr<AsyncRuntime> runtime_; ///< I/O threads, SSL context and connection pool shared by all requests
+    std::shared_ptr<TokenManager> token_manager_; ///< Token shared with the other clients of the process
+    bool succeeded_ = false; ///< Outcome of the last doAction()
+    std::unique_ptr<SyncState> sync_state_; ///< LastUpdateTime watermark of an incremental run (--since-state)
+    std::shared_ptr<ResponseCache> cache_; ///< Cache of EMS responses (--cache-ttl), or nullptr
 
     /**
      * @brief Private constructor for initializing the SMAXClient.
      * @param connection_props Connection parameters for the client.
+     * @param runtime Shared I/O runtime, or nullptr to create one.
+     * @param token_manager Shared token, or nullptr to create one.
+     * @param cache Shared response cache, or nullptr to create one if --cache-ttl is set.
      */
-    explicit SMAXClient(const ConnectionParameters& connection_props);
+    explicit SMAXClient(const ConnectionParameters& connection_props,
+                        std::shared_ptr<AsyncRuntime> runtime = nullptr,
+                        std::shared_ptr<TokenManager> token_manager = nullptr,
+                        std::shared_ptr<ResponseCache> cache = nullptr);
 
     /**
      * @brief Encode a URL parameter (used for filter).
@@ -129,7 +180,11 @@ private:
 
     /**
      * @brief Retrieve data via a GET request.
-     * @return std::string The response data.
+     *
+     * Except for the pretty format on the console, the entities are written to the console
+     * or the output file as they are parsed.
+     * @return std::string The response data, a summary when writing to a file, or an empty
+     * string when the entities were written to the console.
      */
     std::string getData();
 
@@ -147,17 +202,10 @@ private:
 
     /**
      * @brief Save attachments data to a specified directory.
-     * @param data The data to be saved.
+     * @param attachments The attachments to be saved.
      * @return bool True if the attachments were saved successfully, false otherwise.
      */
-    bool saveAttachmentsToDirectory(const std::string& data) const;
-
-    /**
-     * @brief Save JSON data to a specified directory.
-     * @param data The JSON data to be saved.
-     * @return bool True if the JSON was saved successfully, false otherwise.
-     */
-    bool saveJsonToDirectory(const std::string& data) const;
+    bool saveAttachmentsToDirectory(const std::vector<Attachment>& attachments) const;
 
     /**
      * @brief Process the action for JSON data (defined by parameters).
@@ -167,67 +215,91 @@ private:
 
     /**
      * @brief Update the token if it is expired or invalid.
+     *
+     * Waits only if the process has no usable token; the token manager renews it in the
+     * background before it expires.
      */
     void updateToken();
 
     /**
-     * @brief Get the body for the authentication request.
-     * @return std::string The authentication request body.
+     * @brief Create the function the token manager requests tokens with.
+     *
+     * It holds copies of the connection parameters and the runtime, since background
+     * refreshes may outlive this client.
      */
-    std::string getAuthBody() const;
+    TokenManager::Authenticator makeAuthenticator() const;
 
     /**
-     * @brief Perform an HTTP request (GET or POST).
+     * @brief Get the token requests are sent with: the shared one, which may have been renewed since updateToken().
+     */
+    std::string currentToken() const;
+
+    /**
+     * @brief Start a request carrying the token; on 401 the token is renewed and the request sent once more.
      * 
      * @param method The HTTP method (GET, POST, etc.).
      * @param endpoint The request endpoint.
-     * @param port The port to use for the request.
      * @param body The request body (for POST requests).
-     * @param result The response result.
-     * @param headers The request headers.
-     * @param status_code The HTTP status code.
-     * @return bool True if the request was successful, false otherwise.
+     * @param headers The request headers other than the token cookie.
+     * @param callback Receives the response on one of the I/O threads.
      */
-    bool perform_request(boost::beast::http::verb method,
-        const std::string& endpoint,
-        uint16_t port, 
-        const std::string& body, std::string& result, 
-        const std::map<std::string, std::string>& headers, int& status_code) const;
+    void send_authorized(boost::beast::http::verb method, const std::string& endpoint, const std::string& body,
+                         const std::map<std::string, std::string>& headers, AsyncRuntime::Callback callback) const;
 
     /**
-     * @brief Perform a POST request for authentication.
-     * 
-     * @param endpoint The request endpoint.
-     * @param port The port to use.
-     * @param json_body The JSON body of the request.
-     * @param result The response result.
-     * @param status_code The HTTP status code.
-     * @return bool True if the request was successful, false otherwise.
+     * @brief Start a download of an FRS file carrying the token; on 401 the token is renewed and the file downloaded once more.
+     *
+     * @param target The request target.
+     * @param file_path The file receiving the body.
+     * @param callback Receives the result on one of the I/O threads.
+     */
+    void download_authorized(const std::string& target, const std::string& file_path, AsyncRuntime::Callback callback) const;
+
+    /**
+     * @brief Sends a request with the given headers; the token cookie is added by send_with_token.
+     */
+    using Sender = std::function<void(const std::map<std::string, std::string>& headers, AsyncRuntime::Callback callback)>;
+
+    /**
+     * @brief Runs a request with the current token, renewing the token and running it once more on 401.
+     *
+     * @param send Starts the request.
+     * @param headers The request headers other than the token cookie.
+     * @param callback Receives the response on one of the I/O threads.
      */
-    bool auth_post(const std::string& endpoint, uint16_t port, const std::string& json_body, std::string& result, int& status_code) const;
+    void send_with_token(Sender send, std::map<std::string, std::string> headers, AsyncRuntime::Callback callback) const;
 
     /**
-     * @brief Perform a POST request for a regular API request.
+     * @brief Get the body for the authentication request.
+     * @return std::string The authentication request body.
+     */
+    std::string getAuthBody() const;
+
+    /**
+     * @brief Start an HTTP request without waiting for the response.
      * 
+     * @param method The HTTP method (GET, POST, etc.).
      * @param endpoint The request endpoint.
-     * @param port The port to use.
-     * @param json_body The JSON body of the request.
-     * @param result The response result.
-     * @param status_code The HTTP status code.
-     * @return bool True if the request was successful, false otherwise.
+     * @param port The port to use for the request.
+     * @param body The request body (for POST requests).
+     * @param headers The request headers.
+     * @param callback Receives the response on one of the I/O threads.
      */
-    bool request_post(const std::string& endpoint, uint16_t port, const std::string& json_body, std::string& result, int& status_code) const;
+    void perform_request_async(boost::beast::http::verb method,
+        const std::string& endpoint,
+        uint16_t port,
+        const std::string& body,
+        const std::map<std::string, std::string>& headers, AsyncRuntime::Callback callback) const;
 
     /**
-     * @brief Perform a GET request for a regular API request.
-     * 
+     * @brief Start a GET request of an EMS page, answered from the response cache if possible.
+     *
+     * A fresh cached response is passed to the callback on the calling thread. A stale one
+     * is revalidated with its validators; a 304 passes the cached body on as a 200.
      * @param endpoint The request endpoint.
-     * @param port The port to use.
-     * @param result The response result.
-     * @param status_code The HTTP status code.
-     * @return bool True if the request was successful, false otherwise.
+     * @param callback Receives the response.
      */
-    bool request_get(const std::string& endpoint, uint16_t port, std::string& result, int& status_code) const;
+    void request_ems_page(const std::string& endpoint, AsyncRuntime::Callback callback) const;
 
     /**
      * @brief Get request information such as endpoint, headers, etc.
@@ -248,22 +320,27 @@ private:
     std::string getBaseUrl() const;
 
     /**
-     * @brief Parse JSON data from a string.
-     * @param data The JSON string to be parsed.
-     * @return std::string The parsed data.
+     * @brief Send an EMS query and hand the entities of the result to a consumer one by one.
+     *
+     * Every page is parsed in one event-driven pass; an entity is passed on as soon as it
+     * is complete and discarded afterwards. The first page gives meta.total_count; the
+     * following pages are fetched concurrently (up to the configured number in flight) and
+     * consumed in order, so at most that many pages are held in memory. Without a page
+     * size a single request is sent.
+     * @param layout The layout.
+     * @param consumer Receives the entities in result order on the calling thread; an exception
+     * it throws is passed on once the pages in flight are answered.
+     * @param rest Receives the top-level members other than "entities" of the first page.
+     * @param result_status_code The HTTP status code.
+     * @return bool True if all pages were received and parsed.
      */
-    std::string parseJson(const std::string& data);
+    bool streamEntities(const std::string& layout, const EntityConsumer& consumer, json& rest, int& result_status_code);
 
     /**
-     * @brief Send a request to the SMAX system (either GET or POST).
-     * 
-     * @param endpoint The request endpoint.
-     * @param body The request body (for POST requests).
-     * @param isPost Whether the request is a POST request.
-     * @param result_status_code The HTTP status code.
-     * @return std::string The response data.
+     * @brief Stores the watermark of an incremental run; called once all output is written.
+     * @return false if the state file could not be written.
      */
-    std::string sendRequest(const std::string& endpoint, const std::string& body, bool isPost, int & result_status_code);
+    bool saveSyncState() const;
 
     /**
      * @brief Get the port number for the SMAX system.
@@ -273,10 +350,10 @@ private:
 
     /**
      * @brief Save the attachments data to a directory.
-     * @param data The attachments data to be saved.
+     * @param attachments The attachments to be saved.
      * @return bool True if the attachments were saved successfully, false otherwise.
      */
-    bool doSaveAttachments(const std::string& data) const;
+    bool doSaveAttachments(const std::vector<Attachment>& attachments) const;
 };
 
 } // namespace smax_ns
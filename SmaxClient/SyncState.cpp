@@ -0,0 +1,222 @@
+#include "SyncState.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace smax_ns {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Reads a state file; a missing file is an empty state.
+ * @throws std::runtime_error if the file exists but is not a state file.
+ */
+json read_state(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) return json::object();
+
+    json state;
+    try {
+        state = json::parse(in);
+    } catch (const json::exception& e) {
+        throw std::runtime_error("State file " + path + " cannot be read: " + e.what());
+    }
+
+    if (!state.is_object()) {
+        throw std::runtime_error("State file " + path + " is not a state file");
+    }
+
+    return state;
+}
+
+/**
+ * @brief Serializes the saves of a state file within the process (flock is not reliable between threads).
+ */
+std::mutex& path_mutex(const std::string& path) {
+    static std::mutex mutex;
+    static std::map<std::string, std::mutex> mutexes;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return mutexes[fs::absolute(path).lexically_normal().string()];
+}
+
+/**
+ * @brief Exclusive lock on "<path>.lock", which serializes the saves of a state file between processes.
+ */
+class FileLock {
+public:
+    explicit FileLock(const std::string& path) : fd_(::open((path + ".lock").c_str(), O_RDWR | O_CREAT, 0644)) {
+        if (fd_ >= 0 && ::flock(fd_, LOCK_EX) != 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    ~FileLock() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    bool locked() const { return fd_ >= 0; }
+
+private:
+    int fd_;
+};
+
+} // namespace
+
+SyncState::SyncState(std::string path, std::string entity, std::string filter)
+    : path_(std::move(path)), entity_(std::move(entity)), filter_(std::move(filter)),
+      key_(entity_ + "\t" + filter_) {
+    json state = read_state(path_);
+
+    auto it = state.find(key_);
+    if (it != state.end() && it->is_object() && it->contains(FIELD)) {
+        watermark_ = (*it)[FIELD].get<std::int64_t>();
+
+        auto recent = it->find("recent");
+        if (recent != it->end() && recent->is_object()) {
+            for (const auto& [id, time] : recent->items()) {
+                if (time.is_number_integer()) recent_[id] = time.get<std::int64_t>();
+            }
+        }
+    }
+
+    pruned_size_ = recent_.size();
+}
+
+std::optional<std::int64_t> SyncState::getWatermark() const { return watermark_; }
+
+std::string SyncState::getFilter() const {
+    if (!watermark_) return filter_;
+
+    std::string condition = std::string(FIELD) + " >= " + std::to_string(*watermark_ - OVERLAP_MS);
+    return filter_.empty() ? condition : "(" + filter_ + ") and " + condition;
+}
+
+std::string SyncState::withField(const std::string& layout) {
+    std::istringstream fields(layout);
+    std::string field;
+    bool has_id = false;
+    bool has_time = false;
+
+    while (std::getline(fields, field, ',')) {
+        has_id = has_id || field == "Id";
+        has_time = has_time || field == FIELD;
+    }
+
+    // Records of the overlap are recognized by their Id
+    std::string result = layout;
+    if (!has_id) result = result.empty() ? std::string("Id") : result + ",Id";
+    if (!has_time) result += std::string(",") + FIELD;
+
+    return result;
+}
+
+bool SyncState::observe(const json& entity) {
+    auto properties = entity.find("properties");
+    if (properties == entity.end() || !properties->is_object()) {
+        ++records_;
+        return true;
+    }
+
+    auto value = properties->find(FIELD);
+    auto id_value = properties->find("Id");
+    if (value == properties->end() || !value->is_number_integer() || id_value == properties->end()) {
+        ++records_;
+        return true;
+    }
+
+    std::int64_t time = value->get<std::int64_t>();
+    std::string id = id_value->is_string() ? id_value->get<std::string>() : id_value->dump();
+
+    auto delivered = recent_.find(id);
+    if (delivered != recent_.end() && delivered->second == time) return false;
+
+    ++records_;
+    recent_[id] = time;
+    if (!latest_ || time > *latest_) latest_ = time;
+
+    // The final watermark is not smaller than latest_, so older entries will not be kept
+    if (recent_.size() > 2 * pruned_size_ + 1024) prune(*latest_);
+
+    return true;
+}
+
+void SyncState::prune(std::int64_t watermark) {
+    for (auto it = recent_.begin(); it != recent_.end();) {
+        if (it->second < watermark - OVERLAP_MS) it = recent_.erase(it);
+        else ++it;
+    }
+
+    pruned_size_ = recent_.size();
+}
+
+std::size_t SyncState::getRecordCount() const { return records_; }
+
+bool SyncState::save() {
+    // Without new records the watermark and the recent records stay as they are
+    if (!latest_) return true;
+
+    std::int64_t watermark = watermark_ ? std::max(*watermark_, *latest_) : *latest_;
+    prune(watermark);
+
+    // Jobs of this and other processes may have saved their own entity and filter since this
+    // one was loaded; only this key is replaced in the current content of the file
+    std::lock_guard<std::mutex> guard(path_mutex(path_));
+    FileLock lock(path_);
+
+    json state;
+    try {
+        if (!lock.locked()) throw std::runtime_error("State file " + path_ + " cannot be locked");
+        state = read_state(path_);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+
+    state[key_] = {
+        {"entity", entity_},
+        {"filter", filter_},
+        {FIELD, watermark},
+        {"recent", recent_},
+        {"records", records_},
+        {"time", std::chrono::duration_cast<std::chrono::seconds>(
+                     std::chrono::system_clock::now().time_since_epoch()).count()}
+    };
+
+    std::ostringstream suffix;
+    suffix << "." << ::getpid() << "." << std::hex << std::random_device{}() << ".tmp";
+    std::string tmp_path = path_ + suffix.str();
+
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out << state.dump(4) << '\n';
+    out.close();
+
+    std::error_code ec;
+    if (out) fs::rename(tmp_path, path_, ec);
+
+    if (!out || ec) {
+        fs::remove(tmp_path, ec);
+        std::cerr << "Error: Could not write state file " << path_ << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace smax_ns
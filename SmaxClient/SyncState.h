@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+/**
+ * @class SyncState
+ * @brief LastUpdateTime watermark of an incremental export (--since-state).
+ *
+ * The state file holds one watermark per entity and filter:
+ *     {"<entity>\t<filter>": {"entity", "filter", "LastUpdateTime", "recent", "records", "time"}, ...}
+ * A run with a watermark requests the records with a LastUpdateTime not older than the
+ * watermark minus OVERLAP_MS, so records updated in the same millisecond as the watermark or
+ * committed late with an earlier LastUpdateTime are not missed. "recent" maps the Id of every
+ * record delivered within that window to its LastUpdateTime; a record received again with
+ * the same LastUpdateTime is dropped. The largest LastUpdateTime received becomes the
+ * watermark of the next run once save() is called, which the caller does only after all
+ * output has been written.
+ */
+class SyncState {
+public:
+    static constexpr const char* FIELD = "LastUpdateTime";
+
+    /// Milliseconds before the watermark that are requested again
+    static constexpr std::int64_t OVERLAP_MS = 5 * 60 * 1000;
+
+    /**
+     * @brief Loads the watermark of an entity and filter; a missing file has none.
+     * @param path The state file.
+     * @param entity The entity type.
+     * @param filter The EMS filter given by the user (may be empty).
+     * @throws std::runtime_error if the file exists but is not a state file.
+     */
+    SyncState(std::string path, std::string entity, std::string filter);
+
+    SyncState(const SyncState&) = delete;
+    SyncState& operator=(const SyncState&) = delete;
+
+    /** @brief Retrieves the watermark of the previous run. */
+    std::optional<std::int64_t> getWatermark() const;
+
+    /**
+     * @brief Builds the EMS filter of this run.
+     * @return The user filter, combined with "LastUpdateTime >= <watermark - OVERLAP_MS>" if there is a watermark.
+     */
+    std::string getFilter() const;
+
+    /**
+     * @brief Adds Id and LastUpdateTime to an EMS layout that does not request them.
+     */
+    static std::string withField(const std::string& layout);
+
+    /**
+     * @brief Takes the LastUpdateTime of a received entity into account.
+     * @return false if a previous run delivered the entity with the same LastUpdateTime.
+     */
+    bool observe(const json& entity);
+
+    /** @brief Retrieves the number of entities delivered by this run. */
+    std::size_t getRecordCount() const;
+
+    /**
+     * @brief Stores the new watermark; the state of other entities and filters is kept.
+     *
+     * The file is read again under a lock on "<path>.lock" and only this entity and filter
+     * is replaced, so jobs sharing the file do not drop each other's watermarks.
+     * @return false if the file could not be read or written.
+     */
+    bool save();
+
+private:
+    std::string path_;
+    std::string entity_;
+    std::string filter_;
+    std::string key_;                           ///< "<entity>\t<filter>"
+    std::optional<std::int64_t> watermark_;     ///< Watermark of the previous run
+    std::optional<std::int64_t> latest_;        ///< Largest LastUpdateTime received
+    std::map<std::string, std::int64_t> recent_; ///< Id and LastUpdateTime of the records delivered within the overlap
+    std::size_t pruned_size_ = 0;               ///< Size of recent_ after it was last pruned
+    std::size_t records_ = 0;
+
+    /**
+     * @brief Drops the entries of recent_ that are older than the overlap before a watermark.
+     */
+    void prune(std::int64_t watermark);
+};
+
+} // namespace smax_ns
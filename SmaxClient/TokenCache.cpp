@@ -0,0 +1,106 @@
+#include "TokenCache.h"
+
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace smax_ns {
+
+namespace {
+
+/**
+ * @brief Reads the cache file; a missing or damaged file has no tokens.
+ */
+json read_file(const fs::path& path) {
+    std::ifstream in(path);
+    if (!in) return json::object();
+
+    try {
+        json tokens = json::parse(in);
+        if (tokens.is_object()) return tokens;
+    } catch (const json::exception&) {
+    }
+
+    return json::object();
+}
+
+/**
+ * @brief Replaces the cache file, which only its owner can read.
+ */
+bool write_file(const fs::path& path, const json& tokens) {
+    std::error_code ec;
+    if (path.has_parent_path()) fs::create_directories(path.parent_path(), ec);
+
+    // Processes sharing the cache file write temporaries of their own
+    std::ostringstream suffix;
+    suffix << "." << ::getpid() << "." << std::hex << std::random_device{}() << ".tmp";
+
+    fs::path tmp_path = path;
+    tmp_path += suffix.str();
+
+    std::ofstream out(tmp_path, std::ios::trunc);
+    if (!out) return false;
+
+    // Restricted before the token is written
+    fs::permissions(tmp_path, fs::perms::owner_read | fs::perms::owner_write, fs::perm_options::replace, ec);
+    if (ec) {
+        out.close();
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+
+    out << tokens.dump(4);
+    out.close();
+
+    if (!out || (fs::rename(tmp_path, path, ec), ec)) {
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+TokenCache::TokenCache(fs::path path, const std::string& host, std::size_t tenant, const std::string& user)
+    : path_(std::move(path)), key_(host + "\t" + std::to_string(tenant) + "\t" + user) {}
+
+std::optional<TokenInfo> TokenCache::load() const {
+    json tokens = read_file(path_);
+
+    auto it = tokens.find(key_);
+    if (it == tokens.end() || !it->is_object()) return std::nullopt;
+
+    std::string token = it->value("token", "");
+    std::int64_t created = it->value("created", std::int64_t{0});
+    if (token.empty() || created <= 0) return std::nullopt;
+
+    return TokenInfo{token, std::chrono::system_clock::time_point(std::chrono::milliseconds(created))};
+}
+
+bool TokenCache::save(const TokenInfo& token_info) const {
+    json tokens = read_file(path_);
+    tokens[key_] = {
+        {"token", token_info.token},
+        {"created", std::chrono::duration_cast<std::chrono::milliseconds>(token_info.creation_time.time_since_epoch()).count()}
+    };
+
+    if (!write_file(path_, tokens)) {
+        std::cerr << "Warning: the token cannot be cached in " << path_ << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void TokenCache::remove() const {
+    json tokens = read_file(path_);
+    if (tokens.erase(key_) > 0) write_file(path_, tokens);
+}
+
+} // namespace smax_ns
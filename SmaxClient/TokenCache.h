@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace smax_ns {
+
+/**
+ * @brief Structure to hold token information including the token string and its creation time.
+ */
+struct TokenInfo {
+    std::string token; ///< The token string
+    std::chrono::system_clock::time_point creation_time; ///< The creation time of the token
+};
+
+/**
+ * @class TokenCache
+ * @brief Keeps tokens on disk between runs (--token-cache).
+ *
+ * The file holds one token per host, tenant and user:
+ *     {"<host>\t<tenant>\t<user>": {"token", "created"}, ...}
+ * with "created" in milliseconds since the epoch. The file is readable and writable by its
+ * owner only, and it is replaced as a whole, so a concurrent run reads the old or the new file.
+ */
+class TokenCache {
+public:
+    /**
+     * @brief Constructs a TokenCache.
+     * @param path The cache file.
+     * @param host The SMAX host.
+     * @param tenant The tenant ID.
+     * @param user The user name.
+     */
+    TokenCache(fs::path path, const std::string& host, std::size_t tenant, const std::string& user);
+
+    /**
+     * @brief Reads the token of the host, tenant and user, however old it is.
+     * @return The token, or nothing if the file has none.
+     */
+    std::optional<TokenInfo> load() const;
+
+    /**
+     * @brief Stores the token of the host, tenant and user.
+     * @return false (after printing a warning) if the file could not be written.
+     */
+    bool save(const TokenInfo& token_info) const;
+
+    /**
+     * @brief Removes the token of the host, tenant and user, e.g. after the server rejected it.
+     */
+    void remove() const;
+
+private:
+    fs::path path_;
+    std::string key_;
+};
+
+} // namespace smax_ns
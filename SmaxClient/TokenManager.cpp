@@ -0,0 +1,149 @@
+#include "TokenManager.h"
+
+#include <iostream>
+
+namespace smax_ns {
+
+namespace {
+
+constexpr std::chrono::minutes TOKEN_LIFE_TIME{TOKEN_LIFE_TIME_MINUTES};
+constexpr std::chrono::seconds REFRESH_MARGIN{TOKEN_REFRESH_MARGIN_SECONDS};
+
+/// Delay of the next background attempt after a failed one
+constexpr std::chrono::seconds RETRY_DELAY{10};
+
+} // namespace
+
+TokenManager::TokenManager() = default;
+
+TokenManager::~TokenManager() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    changed_.notify_all();
+
+    if (refresher_.joinable()) refresher_.join();
+}
+
+void TokenManager::configure(Authenticator authenticator, std::shared_ptr<TokenCache> cache) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (configured_) return;
+
+    authenticator_ = std::move(authenticator);
+    cache_ = std::move(cache);
+    configured_ = true;
+
+    // A token of a previous run is used until it expires or the server rejects it
+    if (cache_) {
+        token_info_ = cache_->load();
+        if (token_info_ && !isUsable(Clock::now())) token_info_.reset();
+    }
+
+    refresher_ = std::thread(&TokenManager::run, this);
+}
+
+bool TokenManager::isUsable(Clock::time_point now) const {
+    return token_info_.has_value() && now - token_info_->creation_time < TOKEN_LIFE_TIME;
+}
+
+std::optional<TokenInfo> TokenManager::get() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!configured_) return std::nullopt;
+
+    // The refresher renews the token before it expires
+    if (isUsable(Clock::now())) return token_info_;
+
+    std::size_t generation = generation_;
+    if (!refreshing_) refresh_requested_ = true;
+    changed_.notify_all();
+
+    changed_.wait(lock, [&] { return generation_ != generation || stopping_; });
+
+    if (isUsable(Clock::now())) return token_info_;
+    return std::nullopt;
+}
+
+std::optional<std::string> TokenManager::peek() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!token_info_.has_value()) return std::nullopt;
+
+    return token_info_->token;
+}
+
+void TokenManager::renew(const std::string& rejected, RenewCallback callback) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Another request got the same 401 and the token has been replaced since
+    if (token_info_.has_value() && token_info_->token != rejected) {
+        std::string token = token_info_->token;
+        lock.unlock();
+        callback(token);
+        return;
+    }
+
+    bool drop_cached = token_info_.has_value();
+    token_info_.reset();
+
+    waiters_.push_back(std::move(callback));
+    if (!refreshing_) refresh_requested_ = true;
+    lock.unlock();
+    changed_.notify_all();
+
+    if (drop_cached && cache_) cache_->remove();
+}
+
+void TokenManager::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stopping_) {
+        if (!refresh_requested_) {
+            if (!token_info_.has_value()) {
+                changed_.wait(lock, [this] { return refresh_requested_ || stopping_; });
+                continue;
+            }
+
+            auto due = std::max(token_info_->creation_time + TOKEN_LIFE_TIME - REFRESH_MARGIN, retry_at_);
+            changed_.wait_until(lock, due, [this] { return refresh_requested_ || stopping_; });
+
+            if (stopping_ || refresh_requested_ || Clock::now() < due) continue;
+        }
+
+        refresh_requested_ = false;
+        refreshing_ = true;
+        lock.unlock();
+
+        auto fresh = authenticator_();
+        if (fresh && cache_) cache_->save(*fresh);
+
+        lock.lock();
+        refreshing_ = false;
+        ++generation_;
+
+        if (fresh) {
+            token_info_ = fresh;
+        } else {
+            // The current token, if any, stays in use until it expires
+            retry_at_ = Clock::now() + RETRY_DELAY;
+            if (isUsable(Clock::now())) {
+                std::cerr << "Warning: the token could not be renewed, retrying in " << RETRY_DELAY.count() << " s" << std::endl;
+            } else {
+                token_info_.reset();
+            }
+        }
+
+        auto waiters = std::move(waiters_);
+        waiters_.clear();
+        std::optional<std::string> token;
+        if (fresh) token = fresh->token;
+
+        lock.unlock();
+        changed_.notify_all();
+
+        for (auto& waiter : waiters) waiter(token);
+
+        lock.lock();
+    }
+}
+
+} // namespace smax_ns
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TokenCache.h"
+
+namespace smax_ns {
+
+/**
+ * @brief Constant that defines the token life time in minutes.
+ */
+const short TOKEN_LIFE_TIME_MINUTES = 10;
+
+/**
+ * @brief Constant that defines how long before its expiry a token is renewed in the background, in seconds.
+ */
+const short TOKEN_REFRESH_MARGIN_SECONDS = 60;
+
+/**
+ * @class TokenManager
+ * @brief Token shared by the clients of one process.
+ *
+ * All authentication runs on one refresher thread, so at most one request for a token is
+ * in flight and everybody waiting for a token gets the result of that request. The token
+ * is renewed TOKEN_REFRESH_MARGIN_SECONDS before it expires, while requests keep using the
+ * current one; a caller only waits for authentication if there is no usable token at all
+ * (the first request of a process, or after the server rejected the token).
+ */
+class TokenManager {
+public:
+    /// Requests a new token; called on the refresher thread only
+    using Authenticator = std::function<std::optional<TokenInfo>()>;
+
+    /// Receives the renewed token, or nothing if the authentication failed
+    using RenewCallback = std::function<void(std::optional<std::string>)>;
+
+    TokenManager();
+
+    /**
+     * @brief Stops the refresher thread (a running authentication is finished first).
+     */
+    ~TokenManager();
+
+    TokenManager(const TokenManager&) = delete;
+    TokenManager& operator=(const TokenManager&) = delete;
+
+    /**
+     * @brief Sets how tokens are requested and starts the refresher thread; later calls are ignored.
+     * @param authenticator Requests a new token. It must not depend on a client, which may be gone
+     * when a background refresh runs.
+     * @param cache Keeps the token between runs (--token-cache), or nullptr.
+     */
+    void configure(Authenticator authenticator, std::shared_ptr<TokenCache> cache);
+
+    /**
+     * @brief Retrieves a usable token, waiting for an authentication only if there is none.
+     * @return The token, or nothing if the authentication failed.
+     */
+    std::optional<TokenInfo> get();
+
+    /**
+     * @brief Retrieves the current token without waiting.
+     * @return The token, or nothing while there is none.
+     */
+    std::optional<std::string> peek() const;
+
+    /**
+     * @brief Replaces a token the server rejected (401).
+     *
+     * If the token has already been replaced the callback is called at once; otherwise it is
+     * called on the refresher thread with the result of the next authentication, which all
+     * callers rejected with the same token share. Never blocks.
+     * @param rejected The rejected token.
+     * @param callback Receives the new token.
+     */
+    void renew(const std::string& rejected, RenewCallback callback);
+
+private:
+    using Clock = std::chrono::system_clock;
+
+    Authenticator authenticator_;
+    std::shared_ptr<TokenCache> cache_;
+    bool configured_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::optional<TokenInfo> token_info_;
+    bool refresh_requested_ = false;    ///< Somebody waits for the next authentication
+    bool refreshing_ = false;           ///< An authentication is in flight
+    bool stopping_ = false;
+    std::size_t generation_ = 0;        ///< Number of finished authentications
+    Clock::time_point retry_at_{};      ///< Next background attempt after a failed one
+    std::vector<RenewCallback> waiters_; ///< Callers of renew() waiting for the next authentication
+    std::thread refresher_;
+
+    /**
+     * @brief Checks whether a token can still be sent. Must be called with mutex_ held.
+     */
+    bool isUsable(Clock::time_point now) const;
+
+    /**
+     * @brief Body of the refresher thread.
+     */
+    void run();
+};
+
+} // namespace smax_ns
@@ -0,0 +1,161 @@
+/**
+ * @file EmbeddedJsonBenchmark.cpp
+ * @brief Compares the nlohmann::json and simdjson backends of EmbeddedJsonReader.
+ *
+ * Builds fields shaped like EMS attachment and TaskPlan fields, checks that both backends
+ * give the same results (dump() of parsed documents, attachment lists) and prints the time
+ * per field of each backend.
+ *
+ * Usage: embedded_json_benchmark [fields] [attachments per field]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../SmaxClient/EmbeddedJsonReader.h"
+
+using namespace smax_ns;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+std::string makeAttachmentField(std::size_t index, std::size_t attachments) {
+    json field = {{"complexTypeProperties", json::array()}};
+
+    for (std::size_t i = 0; i < attachments; ++i) {
+        field["complexTypeProperties"].push_back({{"properties", {
+            {"id", "6b0b5b3c-" + std::to_string(index) + "-" + std::to_string(i)},
+            {"file_name", "Report \"" + std::to_string(i) + "\" été.pdf"},
+            {"file_extension", "pdf"},
+            {"mime_type", "application/pdf"},
+            {"size", 1024 * (i + 1)},
+            {"LastUpdateTime", 1741194306907 + i},
+            {"Creator", "10016"},
+            {"IsHidden", i % 3 == 2}
+        }}});
+    }
+
+    return field.dump();
+}
+
+std::string makeTaskPlanField(std::size_t index) {
+    json field = {
+        {"UserOptionsName", "Approval plan " + std::to_string(index)},
+        {"Phases", json::array()}
+    };
+
+    for (int phase = 0; phase < 4; ++phase) {
+        json tasks = json::array();
+        for (int task = 0; task < 5; ++task) {
+            tasks.push_back({
+                {"Id", index * 100 + phase * 10 + task},
+                {"Type", "ApprovalTask"},
+                {"Weight", 0.25 * task - 1.5},
+                {"Due", -86400000LL * task},
+                {"Assignees", {"10016", "10017"}},
+                {"Optional", task % 2 == 0},
+                {"Comment", nullptr}
+            });
+        }
+        field["Phases"].push_back({{"Name", "Phase\t" + std::to_string(phase)}, {"Tasks", tasks}});
+    }
+
+    return field.dump();
+}
+
+template <typename Function>
+double measure(std::size_t rounds, Function function) {
+    auto start = Clock::now();
+    for (std::size_t round = 0; round < rounds; ++round) function();
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+bool sameAttachments(const std::vector<Attachment>& a, const std::vector<Attachment>& b) {
+    if (a.size() != b.size()) return false;
+
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (a[i].record_id != b[i].record_id || a[i].id != b[i].id || a[i].file_name != b[i].file_name ||
+            a[i].file_extension != b[i].file_extension || a[i].is_hidden != b[i].is_hidden ||
+            a[i].size != b[i].size || a[i].last_update_time != b[i].last_update_time) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t field_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    std::size_t attachment_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+    const std::size_t rounds = 5;
+
+    std::vector<std::string> attachment_fields;
+    std::vector<std::string> task_plan_fields;
+
+    for (std::size_t i = 0; i < field_count; ++i) {
+        attachment_fields.push_back(makeAttachmentField(i, attachment_count));
+        task_plan_fields.push_back(makeTaskPlanField(i));
+    }
+
+    EmbeddedJsonReader reader;
+    bool identical = true;
+
+    // Results must not depend on the backend
+    for (std::size_t i = 0; i < field_count; ++i) {
+        for (const auto* fields : {&attachment_fields, &task_plan_fields}) {
+            json dom;
+            json simd;
+            bool dom_ok = EmbeddedJsonReader::parseDom((*fields)[i], dom);
+            bool simd_ok = reader.parseSimd((*fields)[i], simd);
+            identical = identical && dom_ok == simd_ok && dom.dump(4) == simd.dump(4);
+        }
+
+        std::vector<Attachment> dom;
+        std::vector<Attachment> simd;
+        std::string error;
+        EmbeddedJsonReader::readAttachmentsDom(std::to_string(i), attachment_fields[i], dom, error);
+        reader.readAttachmentsSimd(std::to_string(i), attachment_fields[i], simd, error);
+        identical = identical && sameAttachments(dom, simd);
+    }
+
+    std::cout << "fields: " << field_count << ", attachments per field: " << attachment_count
+              << ", identical results: " << (identical ? "yes" : "NO") << "\n";
+
+    auto report = [&](const char* name, double dom_us, double simd_us) {
+        double per_field = 1.0 / static_cast<double>(rounds * field_count);
+        std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+                  << " nlohmann " << std::setw(8) << dom_us * per_field << " us/field"
+                  << "   simdjson " << std::setw(8) << simd_us * per_field << " us/field"
+                  << "   speedup " << dom_us / simd_us << "x\n";
+    };
+
+    std::vector<Attachment> sink;
+    std::string error;
+    json document;
+
+    report("attachment list",
+        measure(rounds, [&] {
+            sink.clear();
+            for (const auto& field : attachment_fields) EmbeddedJsonReader::readAttachmentsDom("1", field, sink, error);
+        }),
+        measure(rounds, [&] {
+            sink.clear();
+            for (const auto& field : attachment_fields) reader.readAttachmentsSimd("1", field, sink, error);
+        }));
+
+    report("attachment field to DOM",
+        measure(rounds, [&] { for (const auto& field : attachment_fields) EmbeddedJsonReader::parseDom(field, document); }),
+        measure(rounds, [&] { for (const auto& field : attachment_fields) reader.parseSimd(field, document); }));
+
+    report("TaskPlan field to DOM",
+        measure(rounds, [&] { for (const auto& field : task_plan_fields) EmbeddedJsonReader::parseDom(field, document); }),
+        measure(rounds, [&] { for (const auto& field : task_plan_fields) reader.parseSimd(field, document); }));
+
+    return identical ? 0 : 1;
+}
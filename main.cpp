@@ -1,10 +1,12 @@
 #include <boost/program_options.hpp>
 #include <cstdint>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 
 #include "utils/utils.h"
 #include "SmaxClient/SMAXClient.h"
+#include "SmaxClient/QueryServer.h"
 #include "Parser/Parser.h"
 
 using namespace smax_ns;
@@ -19,23 +21,50 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
+        // Every line of the jobs file is validated on its own
+        if (!input_values.jobs.empty()) {
+            std::vector<smax_ns::JobSpec> jobs;
+            if (!load_jobs(input_values.jobs, input_values.jobs_concurrency, argc, argv, jobs)) {
+                return 1;
+            }
+
+            std::shared_ptr<smax_ns::ResponseCache> cache;
+            if (input_values.cache_ttl > 0) {
+                cache = std::make_shared<smax_ns::ResponseCache>(
+                    std::filesystem::path(input_values.output_folder) / smax_ns::ResponseCache::FOLDER,
+                    std::chrono::seconds(input_values.cache_ttl), input_values.cache_entries);
+            }
+
+            smax_ns::JobRunner runner(std::move(jobs), input_values.jobs_concurrency, input_values.io_threads,
+                                     input_values.request_timeout, cache);
+            return runner.run() ? 0 : 1;
+        }
+
         auto validation_result = validate_input_values(input_values);
         if (validation_result->result != 0) {
             std::cerr << "ERROR: " << validation_result->message << "\n";
             return 1;
         }
 
+        if (!input_values.serve.empty()) {
+            smax_ns::QueryServer server(input_values, input_values.serve);
+            return server.run() ? 0 : 1;
+        }
+
         smax_ns::ConnectionParameters& conn_params = smax_ns::ConnectionParameters::getInstance(input_values);
         smax_ns::SMAXClient& smax_client = smax_ns::SMAXClient::getInstance(conn_params);
 
         auto result = smax_client.doAction();
 
-        std::cout << "**************Response:********************\n";
-        std::cout << result << "\n";
+        // std::cout may carry GET results
+        if (const auto* cache = smax_client.getCache()) {
+            std::cerr << cache->formatSummary() << "\n";
+        }
 
-        if (!input_values.csv.empty()) {
-            smax_ns::Parser parser(input_values.csv);
-            parser.parseCSV(input_values.entity, input_values.action);
+        // Results streamed to the console leave nothing to print
+        if (!result.empty()) {
+            std::cout << "**************Response:********************\n";
+            std::cout << result << "\n";
         }
 
     } catch (const std::exception& e) {
@@ -1,8 +1,13 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <nlohmann/json.hpp>
 #include <string>
+#include <vector>
 
 #include "../SmaxClient/ConnectionProperties.h"
+#include "../SmaxClient/ArchiveWriter.h"
+#include "../SmaxClient/OutputLayout.h"
 #include "utils.h"
 
 namespace po = boost::program_options;
@@ -59,6 +64,10 @@ std::unique_ptr<ValidationResult> validate_json_actions(const InputValues& input
         }
     }
 
+    if (input.json_write_threads == 0 || input.json_max_outstanding == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"JSON write threads and outstanding writes should be greater than 0.", 1});
+    }
+
     return std::make_unique<ValidationResult>(ValidationResult{"", 0});
 }
 
@@ -71,6 +80,10 @@ std::unique_ptr<ValidationResult> validate_attachments_actions(const InputValues
         return std::make_unique<ValidationResult>(ValidationResult{"Attachment folder parameter should not be EMPTY.", 1});
     }
 
+    if (input.att_parallelism == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Attachment parallelism should be greater than 0.", 1});
+    }
+
     if (!is_string_equals(input.att_action_output, "console") && !is_string_equals(input.att_action_output, "file")) {
         return std::make_unique<ValidationResult>(ValidationResult{ "Acceptable action's output values are: file, console.", 1 });
     }
@@ -112,6 +125,42 @@ std::unique_ptr<ValidationResult> validate_input_values(const InputValues& input
     output_result = validate_action(input);
     if (output_result->result != 0) return output_result;
 
+    if (input.page_concurrency == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Page concurrency should be greater than 0.", 1});
+    }
+
+    if (input.bulk_concurrency == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Bulk concurrency should be greater than 0.", 1});
+    }
+
+    if (input.output_format != "pretty" && input.output_format != "json" && input.output_format != "ndjson") {
+        return std::make_unique<ValidationResult>(ValidationResult{"Acceptable output formats are: pretty, json, ndjson.", 1});
+    }
+
+    if (!OutputLayout::isValidMode(input.output_layout)) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Acceptable output layouts are: flat, prefix, hash.", 1});
+    }
+
+    if (ArchiveWriter::isCompressedName(input.output_archive) && !ArchiveWriter::supportsCompression()) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Compressed archives (.zst) need a build with WITH_ZSTD.", 1});
+    }
+
+    if (input.jobs_concurrency == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Number of concurrent jobs should be greater than 0.", 1});
+    }
+
+    if (input.csv_threads == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Number of CSV threads should be greater than 0.", 1});
+    }
+
+    if (input.io_threads == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Number of I/O threads should be greater than 0.", 1});
+    }
+
+    if (input.request_timeout == 0) {
+        return std::make_unique<ValidationResult>(ValidationResult{"Request timeout should be greater than 0.", 1});
+    }
+
     if ((input.action == "CREATE"|| input.action == "UPDATE") && input.csv.empty()) {
         return std::make_unique<ValidationResult>(ValidationResult{"CSV is mandatory for CREATE or UPDATE", 1});
     }
@@ -131,7 +180,12 @@ std::unique_ptr<ValidationResult> validate_input_values(const InputValues& input
     return std::make_unique<ValidationResult>(ValidationResult{"Paremeters are correct.", 0});
 }
 
-bool parse_options(int argc, char* argv[], smax_ns::InputValues& input_values, po::variables_map& vm) {
+namespace {
+
+/**
+ * @brief Describes the command line options, bound to input_values.
+ */
+po::options_description make_options(smax_ns::InputValues& input_values) {
     po::options_description desc("Options", 120);
     desc.add_options()
         ("action", po::value<std::string>(&input_values.action)->required()->default_value("GET"), 
@@ -153,13 +207,47 @@ bool parse_options(int argc, char* argv[], smax_ns::InputValues& input_values, p
         ("json-action-field", po::value<std::string>(&input_values.json_action_field), "Json action field")
         ("json-action-output", po::value<std::string>(&input_values.json_action_output)->default_value("console"), "Json action output")
         ("json-action-output-folder", po::value<std::string>(&input_values.json_action_output_folder), "Json action output folder")
+        ("json-write-threads", po::value<std::size_t>(&input_values.json_write_threads)->default_value(4), "Number of threads writing JSON action files (4 is default)")
+        ("json-max-outstanding", po::value<std::size_t>(&input_values.json_max_outstanding)->default_value(64), "Number of JSON action files queued or being written (64 is default)")
+        ("json-compact", po::bool_switch(&input_values.json_compact)->default_value(false), "Write JSON action files without indentation")
+        ("json-durable", po::bool_switch(&input_values.json_durable)->default_value(false), "Sync JSON action files and their folder to disk")
+        ("output-layout", po::value<std::string>(&input_values.output_layout)->default_value("flat"), "Folder layout of JSON files and attachments (flat is default, prefix, hash)")
+        ("output-archive", po::value<std::string>(&input_values.output_archive), "Tar archive (.tar, or .tar.zst) receiving JSON files and attachments instead of folders")
         ("att-action-output", po::value<std::string>(&input_values.att_action_output)->default_value("console"), "Json action output")
         ("att_action_field", po::value<std::string>(&input_values.att_action_field), "Field with attachments")
         ("att-action-output-folder", po::value<std::string>(&input_values.att_action_output_folder), "Attachments action output folder")
+        ("att-parallelism", po::value<std::size_t>(&input_values.att_parallelism)->default_value(4), "Number of attachment downloads in flight (4 is default)")
+        ("att-refresh", po::bool_switch(&input_values.att_refresh)->default_value(false), "Download all attachments, including the ones the manifest shows unchanged")
+        ("att-dedup", po::bool_switch(&input_values.att_dedup)->default_value(false), "Hard link attachment files with the same content to one stored copy")
+        ("page-size", po::value<std::size_t>(&input_values.page_size)->default_value(1000), "Number of records per EMS page, 0 disables paging (1000 is default)")
+        ("page-concurrency", po::value<std::size_t>(&input_values.page_concurrency)->default_value(4), "Number of EMS pages fetched in parallel (4 is default)")
+        ("bulk-batch-size", po::value<std::size_t>(&input_values.bulk_batch_size)->default_value(100), "Number of entities per bulk request, 0 sends one request (100 is default)")
+        ("bulk-concurrency", po::value<std::size_t>(&input_values.bulk_concurrency)->default_value(4), "Number of bulk requests in flight (4 is default)")
+        ("bulk-retries", po::value<std::size_t>(&input_values.bulk_retries)->default_value(3), "Number of times a bulk entity failed with a retryable status is resent (3 is default)")
+        ("csv-threads", po::value<std::size_t>(&input_values.csv_threads)->default_value(1), "Number of threads parsing the CSV file (1 is default)")
+        ("resume", po::bool_switch(&input_values.resume)->default_value(false), "Resume CREATE or UPDATE from the journal of an interrupted run")
+        ("output-format", po::value<std::string>(&input_values.output_format)->default_value("pretty"), "Format of GET results (pretty is default, json, ndjson)")
+        ("output-file", po::value<std::string>(&input_values.output_file), "File receiving GET results instead of the console")
+        ("since-state", po::value<std::string>(&input_values.since_state), "State file of incremental runs: only records changed since the last run are requested")
+        ("cache-ttl", po::value<std::size_t>(&input_values.cache_ttl)->default_value(0), "Seconds an EMS response is used without a request, 0 disables the response cache (0 is default)")
+        ("cache-entries", po::value<std::size_t>(&input_values.cache_entries)->default_value(256), "Number of EMS responses cached in memory (256 is default)")
+        ("token-cache", po::value<std::string>(&input_values.token_cache), "File keeping the token between runs (owner access only)")
+        ("io-threads", po::value<std::size_t>(&input_values.io_threads)->default_value(4), "Number of network I/O threads (4 is default)")
+        ("request-timeout", po::value<std::size_t>(&input_values.request_timeout)->default_value(120), "Seconds SMAX may take to accept or send data before a request fails (120 is default)")
+        ("jobs", po::value<std::string>(&input_values.jobs), "JSON-lines file of jobs run in one process with a shared token and connections")
+        ("jobs-concurrency", po::value<std::size_t>(&input_values.jobs_concurrency)->default_value(1), "Number of jobs running at the same time (1 is default)")
+        ("serve", po::value<std::string>(&input_values.serve), "Run as a daemon serving queries over HTTP on <address>:<port>, e.g. 127.0.0.1:8080")
+        ("serve-remote", po::bool_switch(&input_values.serve_remote)->default_value(false), "Allow --serve on an address other than loopback (the query API has no authentication)")
         ("help,h", "Help");
 
-    po::store(po::parse_command_line(argc, argv, desc), vm);
+    return desc;
+}
 
+/**
+ * @brief Adds the config file named by --config-file to vm.
+ * @return false if the file cannot be opened.
+ */
+bool store_config_file(const po::options_description& desc, po::variables_map& vm) {
     if (vm.count("config-file")) {
         std::ifstream config_file(vm["config-file"].as<std::string>());
         if (config_file) {
@@ -170,6 +258,53 @@ bool parse_options(int argc, char* argv[], smax_ns::InputValues& input_values, p
         }
     }
 
+    return true;
+}
+
+/**
+ * @brief Options shared by all jobs of a process, which a job must not set.
+ */
+bool is_process_option(const std::string& name) {
+    static const std::vector<std::string> names = {
+        "smax-protocol", "smax-host", "smax-port", "smax-secure-port", "tenant", "username", "password",
+        "io-threads", "request-timeout", "cache-ttl", "cache-entries", "token-cache", "config-file", "jobs", "jobs-concurrency", "serve", "serve-remote", "help"
+    };
+
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+/**
+ * @brief Converts a job object into command line arguments.
+ * @return false if a value is not a string, number or boolean.
+ */
+bool job_to_args(const nlohmann::json& job, std::vector<std::string>& args, std::string& error) {
+    for (const auto& [key, value] : job.items()) {
+        if (key == "name") continue;
+
+        if (value.is_boolean()) {
+            if (value.get<bool>()) args.push_back("--" + key);
+        } else if (value.is_string()) {
+            args.push_back("--" + key + "=" + value.get<std::string>());
+        } else if (value.is_number()) {
+            args.push_back("--" + key + "=" + value.dump());
+        } else if (!value.is_null()) {
+            error = "\"" + key + "\" should be a string, number or boolean";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool parse_options(int argc, char* argv[], smax_ns::InputValues& input_values, po::variables_map& vm) {
+    auto desc = make_options(input_values);
+
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+
+    if (!store_config_file(desc, vm)) return false;
+
     if (vm.count("help")) {
         std::cout << desc << "\n";
         return false;
@@ -179,4 +314,85 @@ bool parse_options(int argc, char* argv[], smax_ns::InputValues& input_values, p
     return true;
 }
 
-}
\ No newline at end of file
+bool load_jobs(const std::string& path, std::size_t concurrency, int argc, char* argv[], std::vector<JobSpec>& jobs) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "ERROR: impossible to open the jobs file " << path << ".\n";
+        return false;
+    }
+
+    std::string line;
+    std::size_t line_number = 0;
+
+    while (std::getline(in, line)) {
+        ++line_number;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        auto fail = [&](const std::string& message) {
+            std::cerr << "ERROR: " << path << ", line " << line_number << ": " << message << "\n";
+            return false;
+        };
+
+        JobSpec job;
+        job.line = line_number;
+
+        std::vector<std::string> args;
+        std::string error;
+
+        try {
+            auto object = nlohmann::json::parse(line);
+            if (!object.is_object()) return fail("a job should be a JSON object");
+
+            job.name = object.value("name", "line " + std::to_string(line_number));
+            if (!job_to_args(object, args, error)) return fail(error);
+
+            // Values stored first win, so the job overrides the command line and the config file
+            auto desc = make_options(job.input_values);
+            po::variables_map vm;
+            auto parsed = po::command_line_parser(args).options(desc).run();
+
+            for (const auto& option : parsed.options) {
+                if (is_process_option(option.string_key)) {
+                    return fail("\"" + option.string_key + "\" is shared by all jobs and can only be given on the command line");
+                }
+            }
+
+            po::store(parsed, vm);
+            po::store(po::parse_command_line(argc, argv, desc), vm);
+            if (!store_config_file(desc, vm)) return false;
+            po::notify(vm);
+        } catch (const std::exception& e) {
+            return fail(e.what());
+        }
+
+        auto validation_result = validate_input_values(job.input_values);
+        if (validation_result->result != 0) return fail(validation_result->message);
+
+        // Pretty GET results are returned as the job result, which is printed as a whole
+        if (concurrency > 1) {
+            const auto& values = job.input_values;
+            const char* console = nullptr;
+
+            if (is_string_equals(values.action, "GET") && values.output_file.empty() && !is_string_equals(values.output_format, "pretty")) {
+                console = "GET results of concurrent jobs need \"output-file\"";
+            } else if (is_string_equals(values.action, "JSON") && is_string_equals(values.json_action_output, "console")) {
+                console = "JSON results of concurrent jobs need \"json-action-output\": \"file\"";
+            } else if (is_string_equals(values.action, "GETATTACHMENTS") && is_string_equals(values.att_action_output, "console")) {
+                console = "attachment lists of concurrent jobs need \"att-action-output\": \"file\"";
+            }
+
+            if (console) return fail(std::string(console) + " (or --jobs-concurrency 1)");
+        }
+
+        jobs.push_back(std::move(job));
+    }
+
+    if (jobs.empty()) {
+        std::cerr << "ERROR: the jobs file " << path << " has no jobs.\n";
+        return false;
+    }
+
+    return true;
+}
+
+}
@@ -5,7 +5,9 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 #include "../SmaxClient/ConnectionProperties.h"
+#include "../SmaxClient/JobRunner.h"
 
 
 namespace po = boost::program_options;
@@ -33,4 +35,16 @@ std::unique_ptr<ValidationResult> validate_input_values(const InputValues& input
 
 bool parse_options(int argc, char* argv[], smax_ns::InputValues& input_values, po::variables_map& vm);
 
+/**
+ * @brief Reads a jobs file (--jobs): one JSON object per line whose keys are long option names.
+ *
+ * Each job starts from the command line and the config file and overrides them with its keys;
+ * "name" names the job in the summary. Connection options are shared and cannot be set by a job.
+ * With more than one job running at a time, a job may not stream its records to the console,
+ * where they would be interleaved with the records of the other jobs.
+ * @param concurrency Number of jobs running at the same time (--jobs-concurrency).
+ * @return false (after printing the error) if a job is invalid.
+ */
+bool load_jobs(const std::string& path, std::size_t concurrency, int argc, char* argv[], std::vector<JobSpec>& jobs);
+
 } // namespace smax_ns